@@ -0,0 +1,467 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "common.h"
+#include "proto.h"
+#include "game.h"
+#include "leaderboard.h"
+#include "crc32c.h"
+
+// Self-contained microbenchmarks for libgame and the game tick.
+// No server is needed. Every benchmark is calibrated so one repetition runs
+// for at least -min-time ms, warmed up, then repeated -reps times; the
+// median, min and max time per operation are reported.
+
+#define MAX_RESULTS 64
+
+#ifndef BENCH_CFLAGS
+#define BENCH_CFLAGS "unknown" // Set by the Makefile; libgame is built with the same flags
+#endif
+
+typedef struct {
+    char name[32];
+    char params[48];
+    size_t bytes;        // Bytes processed per op, 0 if not a throughput benchmark
+    long iters;          // Ops per repetition
+    double median_ns;    // Per op
+    double min_ns;
+    double max_ns;
+} BenchResult;
+
+// Runs iters ops and returns the nanoseconds spent in the measured part
+typedef uint64_t (*BenchFn)(void *ctx, long iters);
+
+static int warmup_reps = 1;
+static int reps = 7;
+static int min_time_ms = 20;
+static const char *filter = NULL;
+static BenchResult results[MAX_RESULTS];
+static int num_results = 0;
+static volatile uint64_t sink; // Keeps results of pure computations alive
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+static void run_bench(const char *name, const char *params, size_t bytes, BenchFn fn, void *ctx) {
+    if (filter && !strstr(name, filter)) return;
+    if (num_results >= MAX_RESULTS) return;
+
+    // Calibrate: grow iters until one repetition takes min_time_ms
+    uint64_t target = (uint64_t)min_time_ms * 1000000ULL;
+    long iters = 1;
+    for (;;) {
+        uint64_t t = fn(ctx, iters);
+        if (t >= target || iters >= (1L << 30)) break;
+        long next = t > 0 ? (long)(iters * (double)target / t * 1.1) : iters * 100;
+        if (next <= iters) next = iters * 2;
+        if (next > iters * 100) next = iters * 100;
+        iters = next;
+    }
+
+    for (int i = 0; i < warmup_reps; i++) fn(ctx, iters);
+
+    double samples[reps];
+    for (int i = 0; i < reps; i++) {
+        samples[i] = (double)fn(ctx, iters) / iters;
+    }
+    qsort(samples, reps, sizeof(double), compare_double);
+
+    BenchResult *r = &results[num_results++];
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    snprintf(r->params, sizeof(r->params), "%s", params);
+    r->bytes = bytes;
+    r->iters = iters;
+    r->median_ns = samples[reps / 2];
+    r->min_ns = samples[0];
+    r->max_ns = samples[reps - 1];
+}
+
+// ---- checksum / xor ----
+
+typedef struct {
+    unsigned char *buf;
+    size_t len;
+} BufCtx;
+
+static uint64_t bench_checksum(void *ctx, long iters) {
+    BufCtx *c = ctx;
+    uint64_t acc = 0;
+    uint64_t start = now_ns();
+    for (long i = 0; i < iters; i++) {
+        acc += calculate_checksum(c->buf, c->len);
+    }
+    uint64_t t = now_ns() - start;
+    sink = acc;
+    return t;
+}
+
+static uint64_t bench_crc32c(void *ctx, long iters) {
+    BufCtx *c = ctx;
+    uint64_t acc = 0;
+    uint64_t start = now_ns();
+    for (long i = 0; i < iters; i++) {
+        acc += crc32c(0, c->buf, c->len);
+    }
+    uint64_t t = now_ns() - start;
+    sink = acc;
+    return t;
+}
+
+static uint64_t bench_crc32c_sw(void *ctx, long iters) {
+    BufCtx *c = ctx;
+    uint64_t acc = 0;
+    uint64_t start = now_ns();
+    for (long i = 0; i < iters; i++) {
+        acc += crc32c_sw(0, c->buf, c->len);
+    }
+    uint64_t t = now_ns() - start;
+    sink = acc;
+    return t;
+}
+
+static uint64_t bench_xor(void *ctx, long iters) {
+    BufCtx *c = ctx;
+    uint64_t start = now_ns();
+    for (long i = 0; i < iters; i++) {
+        xor_cipher(c->buf, c->len);
+    }
+    uint64_t t = now_ns() - start;
+    sink = c->buf[0];
+    return t;
+}
+
+// ---- send_packet / recv_packet over a socketpair ----
+
+typedef struct {
+    int fds[2];
+    void *payload;
+    uint32_t len;
+    int integrity;       // PROTO_SUM or PROTO_CRC32C
+} SockCtx;
+
+static uint64_t bench_packet(void *ctx, long iters) {
+    SockCtx *c = ctx;
+    uint64_t start = now_ns();
+    for (long i = 0; i < iters; i++) {
+        uint16_t opcode;
+        void *data = NULL;
+        uint32_t len;
+        if (send_frame(c->fds[0], OP_UPDATE, c->payload, c->len, c->integrity) < 0 ||
+            recv_frame(c->fds[1], &opcode, &data, &len, NULL) < 0) {
+            fprintf(stderr, "packet round trip failed\n");
+            exit(1);
+        }
+        free(data);
+    }
+    return now_ns() - start;
+}
+
+// ---- worker snapshot: lock, copy the map into an update frame, unlock ----
+
+typedef struct {
+    GameState *gs;
+    UpdateFrame frame;
+} SnapshotCtx;
+
+static uint64_t bench_snapshot(void *ctx, long iters) {
+    SnapshotCtx *c = ctx;
+    uint64_t start = now_ns();
+    for (long i = 0; i < iters; i++) {
+        pthread_mutex_lock(&c->gs->lock);
+        c->frame.header.tick = c->gs->version;
+        c->frame.header.ack_seq = c->gs->applied_seq[0];
+        memcpy(c->frame.map, c->gs->map, sizeof(c->gs->map));
+        pthread_mutex_unlock(&c->gs->lock);
+    }
+    uint64_t t = now_ns() - start;
+    sink = c->frame.map[MAP_HEIGHT / 2][MAP_WIDTH / 2];
+    return t;
+}
+
+// ---- game tick ----
+
+typedef struct {
+    GameState *template; // State before the tick
+    GameState *gs;       // Scratch copy the tick runs on
+} TickCtx;
+
+// Interior cell number k along a serpentine path through the map
+static Point path_cell(int k) {
+    int inner = MAP_WIDTH - 2;
+    int row = k / inner, col = k % inner;
+    Point p;
+    p.y = row + 1;
+    p.x = (row % 2 == 0) ? col + 1 : inner - col;
+    return p;
+}
+
+// Lays out snakes of the given length end to end along the serpentine path,
+// each with one free cell ahead of its head, so a tick moves every snake
+// without collisions. Returns -1 if they do not fit on the map.
+static int build_tick_state(GameState *gs, int players, int length) {
+    int cells = (MAP_WIDTH - 2) * (MAP_HEIGHT - 2);
+    if (players * (length + 1) > cells) return -1;
+
+    memset(gs, 0, sizeof(*gs));
+    for (int y = 0; y < MAP_HEIGHT; y++) {
+        for (int x = 0; x < MAP_WIDTH; x++) {
+            int border = x == 0 || x == MAP_WIDTH - 1 || y == 0 || y == MAP_HEIGHT - 1;
+            gs->map[y][x] = border ? CELL_WALL : CELL_EMPTY;
+        }
+    }
+    for (int i = 0; i < MAX_PLAYERS; i++) gs->player_owner[i] = -1;
+
+    for (int i = 0; i < players; i++) {
+        int base = i * (length + 1);
+        Snake *s = &gs->snakes[i];
+        s->length = length;
+        s->alive = 1;
+        for (int j = 0; j < length; j++) {
+            s->body[j] = path_cell(base + length - 1 - j); // body[0] is the head
+            gs->map[s->body[j].y][s->body[j].x] = CELL_PLAYER_BASE + i;
+        }
+        Point head = s->body[0], next = path_cell(base + length);
+        if (next.x > head.x) s->direction = DIR_RIGHT;
+        else if (next.x < head.x) s->direction = DIR_LEFT;
+        else s->direction = DIR_DOWN;
+        gs->active_players[i] = 1;
+        gs->player_owner[i] = 0;
+    }
+    return 0;
+}
+
+static uint64_t bench_tick(void *ctx, long iters) {
+    TickCtx *c = ctx;
+    TickResult result;
+    uint64_t total = 0;
+    for (long i = 0; i < iters; i++) {
+        memcpy(c->gs, c->template, sizeof(GameState)); // Not timed
+        uint64_t start = now_ns();
+        game_tick(c->gs, &result);
+        total += now_ns() - start;
+    }
+    if (result.num_deaths != 0) {
+        fprintf(stderr, "tick benchmark layout is broken: %d deaths\n", result.num_deaths);
+        exit(1);
+    }
+    return total;
+}
+
+// ---- leaderboard: incremental updates against a full re-sort ----
+
+typedef enum { LB_SCORE, LB_CHURN, LB_REBUILD } LeaderboardOp;
+
+typedef struct {
+    GameState *gs;
+    LeaderboardOp op;
+} LeaderboardCtx;
+
+// Every player active with a spread of scores, ranked
+static void build_leaderboard_state(GameState *gs) {
+    memset(gs, 0, sizeof(*gs));
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        gs->active_players[i] = 1;
+        gs->scores[i] = (i * 37) % 50;
+    }
+    leaderboard_rebuild(gs);
+}
+
+static uint64_t bench_leaderboard(void *ctx, long iters) {
+    LeaderboardCtx *c = ctx;
+    GameState *gs = c->gs;
+    uint64_t start = now_ns();
+    for (long i = 0; i < iters; i++) {
+        int p = (int)((i * 7) % MAX_PLAYERS);
+        switch (c->op) {
+        case LB_SCORE: // A player eats
+            gs->scores[p]++;
+            leaderboard_score(gs, p);
+            break;
+        case LB_CHURN: // A player dies and the slot is taken again
+            leaderboard_remove(gs, p);
+            gs->scores[p] = 0;
+            leaderboard_add(gs, p);
+            break;
+        case LB_REBUILD: // What a sort per change would cost
+            gs->scores[p]++;
+            leaderboard_rebuild(gs);
+            break;
+        }
+    }
+    uint64_t t = now_ns() - start;
+    sink = gs->leaderboard.order[0];
+    return t;
+}
+
+// ---- output ----
+
+static void print_text(FILE *out) {
+    fprintf(out, "cflags: %s\n", BENCH_CFLAGS);
+    fprintf(out, "%-14s %-22s %12s %12s %12s %10s %12s\n",
+            "benchmark", "params", "median ns/op", "min ns/op", "max ns/op", "MB/s", "iters/rep");
+    for (int i = 0; i < num_results; i++) {
+        BenchResult *r = &results[i];
+        fprintf(out, "%-14s %-22s %12.1f %12.1f %12.1f ", r->name, r->params, r->median_ns, r->min_ns, r->max_ns);
+        if (r->bytes) fprintf(out, "%10.1f", r->bytes * 1000.0 / r->median_ns);
+        else fprintf(out, "%10s", "-");
+        fprintf(out, " %12ld\n", r->iters);
+    }
+}
+
+static void print_csv(FILE *out) {
+    fprintf(out, "benchmark,params,median_ns,min_ns,max_ns,mb_per_sec,iters,cflags\n");
+    for (int i = 0; i < num_results; i++) {
+        BenchResult *r = &results[i];
+        fprintf(out, "%s,\"%s\",%.1f,%.1f,%.1f,%.1f,%ld,\"%s\"\n", r->name, r->params,
+                r->median_ns, r->min_ns, r->max_ns,
+                r->bytes ? r->bytes * 1000.0 / r->median_ns : 0.0, r->iters, BENCH_CFLAGS);
+    }
+}
+
+static void print_json(FILE *out, int cpu) {
+    fprintf(out, "{\n  \"reps\": %d,\n  \"min_time_ms\": %d,\n  \"cpu\": %d,\n  \"cflags\": \"%s\",\n  \"results\": [\n",
+            reps, min_time_ms, cpu, BENCH_CFLAGS);
+    for (int i = 0; i < num_results; i++) {
+        BenchResult *r = &results[i];
+        fprintf(out, "    {\"benchmark\": \"%s\", \"params\": \"%s\", \"median_ns\": %.1f, "
+                "\"min_ns\": %.1f, \"max_ns\": %.1f, \"mb_per_sec\": %.1f, \"iters\": %ld}%s\n",
+                r->name, r->params, r->median_ns, r->min_ns, r->max_ns,
+                r->bytes ? r->bytes * 1000.0 / r->median_ns : 0.0, r->iters,
+                i + 1 < num_results ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-cpu n] [-reps n] [-warmup n] [-min-time ms] "
+            "[-filter name] [-format text|csv|json]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    int cpu = -1;
+    const char *format = "text";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-cpu") == 0 && i + 1 < argc) {
+            cpu = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-reps") == 0 && i + 1 < argc) {
+            reps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-warmup") == 0 && i + 1 < argc) {
+            warmup_reps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-min-time") == 0 && i + 1 < argc) {
+            min_time_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "-format") == 0 && i + 1 < argc) {
+            format = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (reps < 1) reps = 1;
+    if (min_time_ms < 1) min_time_ms = 1;
+
+    // Pin to one CPU so migrations do not show up as noise
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+            perror("sched_setaffinity");
+            return 1;
+        }
+    }
+
+    char params[48];
+
+    size_t buf_sizes[] = { 64, sizeof(UpdateFrame), 65536 };
+    for (int i = 0; i < 3; i++) {
+        BufCtx c;
+        c.len = buf_sizes[i];
+        c.buf = malloc(c.len);
+        for (size_t j = 0; j < c.len; j++) c.buf[j] = (unsigned char)(j * 31);
+        snprintf(params, sizeof(params), "bytes=%zu", c.len);
+        run_bench("checksum", params, c.len, bench_checksum, &c);
+        run_bench("crc32c_sw", params, c.len, bench_crc32c_sw, &c);
+        snprintf(params, sizeof(params), "bytes=%zu,%s", c.len, crc32c_impl());
+        run_bench("crc32c", params, c.len, bench_crc32c, &c);
+        snprintf(params, sizeof(params), "bytes=%zu", c.len);
+        run_bench("xor_cipher", params, c.len, bench_xor, &c);
+        free(c.buf);
+    }
+
+    uint32_t packet_sizes[] = { 0, sizeof(MovePayload), sizeof(UpdateFrame) };
+    for (int i = 0; i < 6; i++) {
+        SockCtx c;
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, c.fds) < 0) {
+            perror("socketpair");
+            return 1;
+        }
+        c.len = packet_sizes[i % 3];
+        c.integrity = i < 3 ? PROTO_SUM : PROTO_CRC32C;
+        c.payload = calloc(1, c.len + 1);
+        snprintf(params, sizeof(params), "payload=%u%s", c.len, c.integrity == PROTO_CRC32C ? ",crc32c" : "");
+        run_bench("packet_rtt", params, proto_header_size(c.integrity) + c.len, bench_packet, &c);
+        free(c.payload);
+        close(c.fds[0]);
+        close(c.fds[1]);
+    }
+
+    GameState *gs = malloc(sizeof(GameState));
+    GameState *template = malloc(sizeof(GameState));
+    if (!gs || !template) {
+        perror("malloc");
+        return 1;
+    }
+
+    SnapshotCtx *snap = malloc(sizeof(SnapshotCtx));
+    memset(gs, 0, sizeof(GameState));
+    game_init(gs, 1);
+    pthread_mutex_init(&gs->lock, NULL);
+    snap->gs = gs;
+    run_bench("snapshot", "map", sizeof(gs->map), bench_snapshot, snap);
+    pthread_mutex_destroy(&gs->lock);
+    free(snap);
+
+    int player_counts[] = { 1, 10, 50, 100 };
+    int lengths[] = { 1, 4, 12 };
+    for (int p = 0; p < 4; p++) {
+        for (int l = 0; l < 3; l++) {
+            if (build_tick_state(template, player_counts[p], lengths[l]) < 0) continue;
+            TickCtx c = { template, gs };
+            snprintf(params, sizeof(params), "players=%d,len=%d", player_counts[p], lengths[l]);
+            run_bench("game_tick", params, 0, bench_tick, &c);
+        }
+    }
+
+    const char *lb_names[] = { "score", "remove+add", "rebuild" };
+    for (int op = LB_SCORE; op <= LB_REBUILD; op++) {
+        LeaderboardCtx c = { gs, op };
+        build_leaderboard_state(gs);
+        snprintf(params, sizeof(params), "%s,players=%d", lb_names[op], MAX_PLAYERS);
+        run_bench("leaderboard", params, 0, bench_leaderboard, &c);
+    }
+    free(gs);
+    free(template);
+
+    if (strcmp(format, "csv") == 0) print_csv(stdout);
+    else if (strcmp(format, "json") == 0) print_json(stdout, cpu);
+    else print_text(stdout);
+    return 0;
+}
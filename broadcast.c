@@ -0,0 +1,52 @@
+#include "broadcast.h"
+#include "proto.h"
+#include "crc32c.h"
+
+#include <string.h>
+#include <arpa/inet.h>
+
+#define BROADCAST_READ_TRIES 4
+
+void broadcast_publish(BroadcastRing *r, const UpdateFrame *frame) {
+    uint64_t n = r->published;
+    BroadcastSlot *s = &r->slots[n % BROADCAST_SLOTS];
+    uint32_t seq = s->seq;
+
+    __atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    encode_packet(s->data, sizeof(s->data), OP_UPDATE, frame, sizeof(*frame));
+    __atomic_store_n(&s->tick, frame->header.tick, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+
+    __atomic_store_n(&r->published, n + 1, __ATOMIC_RELEASE);
+}
+
+int broadcast_read(const BroadcastRing *r, uint64_t after, unsigned char *out, uint64_t *tick) {
+    for (int i = 0; i < BROADCAST_READ_TRIES; i++) {
+        uint64_t n = __atomic_load_n(&r->published, __ATOMIC_ACQUIRE);
+        if (n == 0) return 0;
+        const BroadcastSlot *s = &r->slots[(n - 1) % BROADCAST_SLOTS];
+
+        uint32_t seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) continue;
+        uint64_t t = __atomic_load_n(&s->tick, __ATOMIC_RELAXED);
+        if (t <= after) return 0; // Cheap check first: most polls find nothing new
+
+        memcpy(out, s->data, sizeof(s->data));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) != seq) continue;
+        *tick = t;
+        return 1;
+    }
+    return -1;
+}
+
+void broadcast_to_crc32c(const unsigned char *frame, unsigned char *out) {
+    ExtendedHeader h;
+    memcpy(&h.base, frame, sizeof(h.base));
+    h.base.opcode = htons(OP_UPDATE | OP_FLAG_CRC32C);
+    h.base.checksum = 0;
+    memcpy(out + sizeof(h), frame + sizeof(h.base), sizeof(UpdateFrame));
+    h.crc32c = htonl(crc32c(0, out + sizeof(h), sizeof(UpdateFrame)));
+    memcpy(out, &h, sizeof(h));
+}
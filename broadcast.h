@@ -0,0 +1,25 @@
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include "common.h"
+
+// Spectator frames (game_state->broadcast). After each tick the game loop
+// encodes one OP_UPDATE packet for everyone watching and publishes it in the
+// next ring slot under a seqlock. Workers copy the newest slot without
+// taking the game lock and stream the same bytes to all their spectators.
+// The ring has several slots so a reader copying the newest frame is not
+// overwritten by the next tick.
+
+// Game loop only (single writer)
+void broadcast_publish(BroadcastRing *r, const UpdateFrame *frame);
+
+// Copies the newest frame into out (BROADCAST_FRAME_SIZE bytes) if its tick
+// is after `after`. Returns 1 and sets *tick if it did, 0 if there is nothing
+// newer, -1 if the slot kept changing under the reader (try again later).
+int broadcast_read(const BroadcastRing *r, uint64_t after, unsigned char *out, uint64_t *tick);
+
+// Re-frames a copied frame with an ExtendedHeader for spectators using
+// CRC32C. out holds BROADCAST_CRC_FRAME_SIZE bytes.
+void broadcast_to_crc32c(const unsigned char *frame, unsigned char *out);
+
+#endif
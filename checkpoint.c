@@ -0,0 +1,136 @@
+#include "checkpoint.h"
+#include "leaderboard.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static CheckpointFile *checkpoint_file = NULL;
+
+// FNV-1a over 64-bit words
+static uint64_t world_hash(const CheckpointWorld *w) {
+    const uint64_t *p = (const uint64_t *)w;
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < sizeof(*w) / 8; i++) {
+        h ^= p[i];
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+int checkpoint_open(const char *path) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        perror("checkpoint open");
+        return -1;
+    }
+
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size != (off_t)sizeof(CheckpointFile) && ftruncate(fd, sizeof(CheckpointFile)) == -1) {
+        perror("checkpoint ftruncate");
+        close(fd);
+        return -1;
+    }
+
+    void *mem = mmap(NULL, sizeof(CheckpointFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        perror("checkpoint mmap");
+        return -1;
+    }
+
+    CheckpointFile *f = mem;
+    if (f->magic != CHECKPOINT_MAGIC || f->version != CHECKPOINT_VERSION ||
+        f->world_size != sizeof(CheckpointWorld) || f->map_width != MAP_WIDTH ||
+        f->map_height != MAP_HEIGHT || f->max_players != MAX_PLAYERS ||
+        f->max_snake_length != MAX_SNAKE_LENGTH) {
+        if (f->magic != 0) fprintf(stderr, "%s: incompatible checkpoint, starting a new one\n", path);
+        memset(f, 0, sizeof(*f));
+        f->magic = CHECKPOINT_MAGIC;
+        f->version = CHECKPOINT_VERSION;
+        f->world_size = sizeof(CheckpointWorld);
+        f->map_width = MAP_WIDTH;
+        f->map_height = MAP_HEIGHT;
+        f->max_players = MAX_PLAYERS;
+        f->max_snake_length = MAX_SNAKE_LENGTH;
+    }
+
+    checkpoint_file = f;
+    return 0;
+}
+
+void checkpoint_close(void) {
+    if (checkpoint_file == NULL) return;
+    msync(checkpoint_file, sizeof(CheckpointFile), MS_SYNC);
+    munmap(checkpoint_file, sizeof(CheckpointFile));
+    checkpoint_file = NULL;
+}
+
+void checkpoint_capture(const GameState *gs, CheckpointWorld *w) {
+    memset(w, 0, sizeof(*w)); // Zero Snake padding so the hash is stable
+    w->version = gs->version;
+    w->rng_state = gs->rng_state;
+    memcpy(w->map, gs->map, sizeof(w->map));
+    memcpy(w->scores, gs->scores, sizeof(w->scores));
+    memcpy(w->active_players, gs->active_players, sizeof(w->active_players));
+    memcpy(w->player_token, gs->player_token, sizeof(w->player_token));
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (!gs->active_players[i]) continue; // Dead slots keep stale bodies; skip them
+        memcpy(&w->snakes[i], &gs->snakes[i], sizeof(Snake));
+    }
+}
+
+uint64_t checkpoint_write(const CheckpointWorld *w) {
+    if (checkpoint_file == NULL) return 0;
+    CheckpointSlot *a = &checkpoint_file->slots[0];
+    CheckpointSlot *b = &checkpoint_file->slots[1];
+    CheckpointSlot *slot = a->seq <= b->seq ? a : b;
+    uint64_t seq = (a->seq > b->seq ? a->seq : b->seq) + 1;
+
+    __atomic_store_n(&slot->seq, 0, __ATOMIC_RELEASE);
+    memcpy(&slot->world, w, sizeof(*w));
+    slot->hash = world_hash(&slot->world);
+    slot->saved_at = (uint64_t)time(NULL);
+    __atomic_store_n(&slot->seq, seq, __ATOMIC_RELEASE);
+
+    // Writeback is left to the kernel; only shutdown waits for it
+    msync(checkpoint_file, sizeof(CheckpointFile), MS_ASYNC);
+    return seq;
+}
+
+uint64_t checkpoint_load(CheckpointWorld *w) {
+    if (checkpoint_file == NULL) return 0;
+    CheckpointSlot *best = NULL;
+    for (int i = 0; i < 2; i++) {
+        CheckpointSlot *slot = &checkpoint_file->slots[i];
+        if (slot->seq == 0 || world_hash(&slot->world) != slot->hash) continue;
+        if (best == NULL || slot->seq > best->seq) best = slot;
+    }
+    if (best == NULL) return 0;
+    memcpy(w, &best->world, sizeof(*w));
+    return best->seq;
+}
+
+int checkpoint_apply(GameState *gs, const CheckpointWorld *w, uint64_t resume_deadline) {
+    int players = 0;
+    gs->version = w->version;
+    gs->rng_state = w->rng_state;
+    memcpy(gs->map, w->map, sizeof(gs->map));
+    memcpy(gs->scores, w->scores, sizeof(gs->scores));
+    memcpy(gs->player_token, w->player_token, sizeof(gs->player_token));
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        gs->snakes[i] = w->snakes[i];
+        gs->active_players[i] = w->active_players[i];
+        gs->player_owner[i] = -1;
+        gs->detached[i] = w->active_players[i];
+        gs->move_seq[i] = 0;
+        gs->applied_seq[i] = 0;
+        if (w->active_players[i]) players++;
+    }
+    gs->resume_deadline = players > 0 ? resume_deadline : 0;
+    leaderboard_rebuild(gs);
+    return players;
+}
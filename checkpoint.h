@@ -0,0 +1,70 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+
+#include "common.h"
+
+// World checkpoints in a memory-mapped file, for warm restarts.
+// The file has two slots. A checkpoint is copied out of the shared segment
+// under the game lock (checkpoint_capture), then written to the older slot
+// without the lock (checkpoint_write). A slot is invalidated before it is
+// rewritten and sealed with a sequence number and hash afterwards, so a crash
+// mid-write still leaves the other slot intact; loading picks the newest
+// slot whose hash checks out.
+
+#define CHECKPOINT_MAGIC   0x54504B434B4E53ULL // "SNKCKPT"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_INTERVAL_TICKS 25 // Every 5 seconds at the default tick rate
+
+// The part of GameState that survives a restart
+typedef struct {
+    uint64_t version;
+    uint64_t rng_state;
+    int map[MAP_HEIGHT][MAP_WIDTH];
+    int scores[MAX_PLAYERS];
+    int active_players[MAX_PLAYERS];
+    Snake snakes[MAX_PLAYERS];
+    uint32_t player_token[MAX_PLAYERS];
+} CheckpointWorld;
+
+typedef struct {
+    uint64_t seq;        // 0 while the slot is being written
+    uint64_t hash;       // Of world
+    uint64_t saved_at;   // Unix time
+    uint64_t reserved;
+    CheckpointWorld world;
+} CheckpointSlot;
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t world_size;
+    uint32_t map_width;
+    uint32_t map_height;
+    uint32_t max_players;
+    uint32_t max_snake_length;
+    uint8_t reserved[32];
+    CheckpointSlot slots[2];
+} CheckpointFile;
+
+// Maps the file, creating or reformatting it if needed. The mapping is
+// shared with children forked afterwards. Returns 0 or -1.
+int checkpoint_open(const char *path);
+void checkpoint_close(void);
+
+// Copies the world out of gs. Call with the game lock held.
+void checkpoint_capture(const GameState *gs, CheckpointWorld *w);
+
+// Writes w to the older slot and schedules it for writeback.
+// Returns the new checkpoint's sequence number, or 0 if no file is open.
+uint64_t checkpoint_write(const CheckpointWorld *w);
+
+// Copies the newest valid checkpoint into w. Returns its sequence number, or 0 if none.
+uint64_t checkpoint_load(CheckpointWorld *w);
+
+// Installs w into gs. Its players come back detached, frozen until their
+// clients resume them or resume_deadline passes. Returns the number of players.
+int checkpoint_apply(GameState *gs, const CheckpointWorld *w, uint64_t resume_deadline);
+
+#endif
@@ -1,26 +1,62 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <pthread.h>
 #include <termios.h>
 #include <sys/time.h>
+#include <signal.h>
+
+#include <time.h>
 
 #include "common.h"
 #include "proto.h"
+#include "hdr_histogram.h"
+#include "loadgen.h"
+#include "render.h"
+#include "predict.h"
 
 int sockfd;
 int my_id = -1;
+uint32_t my_token = 0; // For -resume after a server restart
+Screen screen;
+Predictor predictor;
+pthread_mutex_t screen_lock = PTHREAD_MUTEX_INITIALIZER; // predictor + screen: input and recv threads both render
+volatile sig_atomic_t screen_resized = 0;
+uint64_t last_tick = 0; // Newest OP_UPDATE shown, from either channel
+ScoresPayload scores;   // Newest OP_SCORES, under screen_lock
+
+// Datagram channel (-udp): updates and moves, TCP keeps login, heartbeat and control
+int udp_fd = -1;
+uint32_t udp_seq_out = 0;
+uint32_t udp_seq_in = 0;
+volatile int udp_up = 0; // An update has arrived over UDP, so the server has our address
+unsigned long udp_updates = 0, udp_stale = 0, udp_lost = 0;
 int running = 1;
 int stress_mode = 0;
+int spectating = 0; // -spectate: watch only, no player slot
+
+// For stress test stats. Each thread owns its histograms; they are merged after join.
+typedef struct {
+    pthread_t thread;
+    unsigned int seed;
+    int connected;
+    long requests;
+    HdrHistogram connect_us;  // connect() duration
+    HdrHistogram login_us;    // OP_LOGIN_REQ -> OP_LOGIN_RESP
+    HdrHistogram rtt_us;      // OP_MOVE -> next packet from the server
+    HdrHistogram tick_rtt_us; // OP_MOVE -> OP_UPDATE of the tick that applied it
+} StressThread;
 
-// For stress test stats
-long total_rtt = 0;
-long total_requests = 0;
-long successful_connections = 0;
 struct timeval stress_start_time, stress_end_time;
-pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+uint64_t now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
 
 void set_nonblocking_input(int enable) {
     static struct termios oldt, newt;
@@ -34,20 +70,128 @@ void set_nonblocking_input(int enable) {
     }
 }
 
-void render_map(int map[MAP_HEIGHT][MAP_WIDTH]) {
-    printf("\033[H\033[J"); // Clear screen
-    for (int y = 0; y < MAP_HEIGHT; y++) {
-        for (int x = 0; x < MAP_WIDTH; x++) {
-            int cell = map[y][x];
-            if (cell == CELL_WALL) printf("#");
-            else if (cell == CELL_FOOD) printf("@");
-            else if (cell == CELL_EMPTY) printf(" ");
-            else if (cell == CELL_PLAYER_BASE + my_id) printf("O"); // Me
-            else printf("X"); // Others
+void handle_sigwinch(int sig) {
+    screen_resized = 1;
+}
+
+// Called with screen_lock held
+void render_map() {
+    char glyphs[MAP_HEIGHT][MAP_WIDTH];
+    predict_glyphs(&predictor, my_id, glyphs);
+
+    char status[RENDER_STATUS_MAX];
+    if (spectating) {
+        snprintf(status, sizeof(status), "Spectating | Q to Quit | Tick: %llu", (unsigned long long)last_tick);
+    } else {
+        snprintf(status, sizeof(status), "Player ID: %d | Controls: W/A/S/D | Q to Quit | Resume: -resume %d:%08x | Corrections: %.1f%%",
+                 my_id, my_id, my_token,
+                 predictor.compared ? 100.0 * predictor.corrections / predictor.compared : 0.0);
+    }
+    // Top three, as much as fits
+    for (uint32_t i = 0; i < scores.count && i < 3; i++) {
+        size_t used = strlen(status);
+        snprintf(status + used, sizeof(status) - used, "%s%d:%d", i == 0 ? " | Top: " : " ",
+                 scores.entries[i].player_id, scores.entries[i].score);
+    }
+
+    if (screen_resized) {
+        screen_resized = 0;
+        render_invalidate(&screen);
+    }
+    render_frame(&screen, glyphs, status);
+}
+
+// Frames can come over TCP and UDP; anything older than what is on screen is dropped
+void show_update(const UpdateFrame *frame) {
+    pthread_mutex_lock(&screen_lock);
+    if (frame->header.tick > last_tick) {
+        last_tick = frame->header.tick;
+        predict_update(&predictor, frame);
+        render_map();
+    }
+    pthread_mutex_unlock(&screen_lock);
+}
+
+int udp_send(uint16_t opcode, const void *payload, uint32_t len) {
+    unsigned char buf[sizeof(ExtendedHeader) + sizeof(UdpMove)];
+    int n = encode_packet(buf, sizeof(buf), opcode, payload, len);
+    if (n < 0) return -1;
+    return send(udp_fd, buf, n, 0) == n ? 0 : -1;
+}
+
+void udp_send_hello() {
+    UdpHeader h = { my_id, my_token, ++udp_seq_out };
+    udp_send(OP_UDP_HELLO, &h, sizeof(h));
+}
+
+// Asks for the datagram channel and says hello from a connected UDP socket.
+// Called before the threads start; on any failure the client stays on TCP.
+void udp_open(const struct sockaddr_in *server) {
+    uint16_t opcode;
+    void *payload = NULL;
+    uint32_t len;
+
+    if (send_packet(sockfd, OP_UDP_REQ, NULL, 0) < 0 || recv_packet(sockfd, &opcode, &payload, &len) < 0) {
+        if (payload) free(payload);
+        return;
+    }
+    // Updates may already be queued ahead of the response; they are redrawn next tick
+    while (opcode != OP_UDP_RESP) {
+        free(payload);
+        payload = NULL;
+        if (recv_packet(sockfd, &opcode, &payload, &len) < 0) {
+            if (payload) free(payload);
+            return;
+        }
+    }
+    UdpResponse resp = { 0, 0 };
+    if (len >= sizeof(resp)) memcpy(&resp, payload, sizeof(resp));
+    free(payload);
+    if (resp.port == 0) {
+        printf("Server has no UDP channel, using TCP.\n");
+        return;
+    }
+
+    struct sockaddr_in addr = *server;
+    addr.sin_port = resp.port;
+    udp_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (udp_fd < 0 || connect(udp_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("udp");
+        if (udp_fd >= 0) close(udp_fd);
+        udp_fd = -1;
+        return;
+    }
+    struct timeval tv = { 0, 200000 }; // So the thread notices running = 0
+    setsockopt(udp_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    udp_send_hello();
+    printf("UDP channel on port %u.\n", ntohs(resp.port));
+}
+
+void *udp_recv_thread_func(void *arg) {
+    unsigned char buf[sizeof(ExtendedHeader) + sizeof(UdpUpdate)];
+    while (running) {
+        ssize_t n = recv(udp_fd, buf, sizeof(buf), 0);
+        if (n <= 0) continue; // Timeout, or ICMP error from a restarting server
+
+        uint16_t opcode;
+        unsigned char *payload;
+        uint32_t len;
+        if (decode_packet(buf, n, &opcode, &payload, &len) != n || opcode != OP_UPDATE ||
+            len != sizeof(UdpUpdate)) continue;
+
+        UdpUpdate *u = (UdpUpdate *)payload;
+        if (u->udp.player_id != my_id || u->udp.token != my_token) continue;
+        if (u->udp.seq <= udp_seq_in) {
+            udp_stale++;
+            continue;
         }
-        printf("\n");
+        udp_lost += u->udp.seq - udp_seq_in - 1;
+        udp_seq_in = u->udp.seq;
+        udp_updates++;
+        udp_up = 1;
+        show_update(&u->frame);
     }
-    printf("Player ID: %d | Controls: W/A/S/D | Q to Quit\n", my_id);
+    return NULL;
 }
 
 void *recv_thread_func(void *arg) {
@@ -65,10 +209,22 @@ void *recv_thread_func(void *arg) {
 
         if (opcode == OP_UPDATE) {
             if (!stress_mode) {
-                if (len == sizeof(int) * MAP_HEIGHT * MAP_WIDTH) {
-                    int (*map)[MAP_WIDTH] = (int (*)[MAP_WIDTH])payload;
-                    render_map(map);
+                if (len == sizeof(UpdateFrame)) {
+                    // The server only falls back to TCP updates when it lost our UDP session (e.g. upgrade)
+                    udp_up = 0;
+                    show_update((UpdateFrame *)payload);
+                }
+            }
+        } else if (opcode == OP_SCORES) {
+            ScoresPayload *p = payload;
+            if (!stress_mode && len >= offsetof(ScoresPayload, entries) && p->count <= LEADERBOARD_SIZE &&
+                len == offsetof(ScoresPayload, entries) + p->count * sizeof(ScoreEntry)) {
+                pthread_mutex_lock(&screen_lock);
+                if (p->version > scores.version) {
+                    memcpy(&scores, p, len);
+                    render_map();
                 }
+                pthread_mutex_unlock(&screen_lock);
             }
         } else if (opcode == OP_DIE) {
             printf("You Died!\n");
@@ -88,7 +244,8 @@ void *recv_thread_func(void *arg) {
 void *heartbeat_thread_func(void *arg) {
     while (running) {
         sleep(HEARTBEAT_INTERVAL_SEC);
-        if (running && my_id >= 0) {
+        if (running && (my_id >= 0 || spectating)) {
+            if (udp_fd >= 0 && !udp_up) udp_send_hello(); // Lost, or the server has not bound us yet
             if (send_packet(sockfd, OP_HEARTBEAT, NULL, 0) < 0) {
                 printf("Failed to send heartbeat, connection may be lost.\n");
                 running = 0;
@@ -107,12 +264,26 @@ void *input_thread_func(void *arg) {
             running = 0;
             break;
         }
+        if (spectating) continue;
         if (c == 'w' || c == 'a' || c == 's' || c == 'd' || 
             c == 'W' || c == 'A' || c == 'S' || c == 'D') {
             
-            char dir = c;
-            if (dir >= 'a' && dir <= 'z') dir -= 32; // To upper
-            send_packet(sockfd, OP_MOVE, &dir, 1);
+            MovePayload move;
+            move.direction = c;
+            if (move.direction >= 'a' && move.direction <= 'z') move.direction -= 32; // To upper
+
+            // Show the move now; the server's frame for the next tick confirms it
+            pthread_mutex_lock(&screen_lock);
+            move.seq = predict_input(&predictor, move.direction);
+            if (predictor.have_auth) render_map();
+            pthread_mutex_unlock(&screen_lock);
+            if (udp_up) {
+                // Unreliable: a lost move shows up as a prediction correction
+                UdpMove m = { { my_id, my_token, ++udp_seq_out }, move };
+                udp_send(OP_MOVE, &m, sizeof(m));
+            } else {
+                send_packet(sockfd, OP_MOVE, &move, sizeof(move));
+            }
         }
     }
     set_nonblocking_input(0);
@@ -120,6 +291,7 @@ void *input_thread_func(void *arg) {
 }
 
 void *stress_client_thread(void *arg) {
+    StressThread *t = (StressThread *)arg;
     int sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock < 0) {
         perror("socket");
@@ -131,16 +303,16 @@ void *stress_client_thread(void *arg) {
     serv_addr.sin_port = htons(PORT);
     inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr);
 
+    uint64_t start = now_us();
     if (connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
         close(sock);
         return NULL;
     }
-
-    pthread_mutex_lock(&stats_lock);
-    successful_connections++;
-    pthread_mutex_unlock(&stats_lock);
+    hdr_record(&t->connect_us, now_us() - start);
+    t->connected = 1;
 
     // Login
+    start = now_us();
     if (send_packet(sock, OP_LOGIN_REQ, NULL, 0) < 0) {
         close(sock);
         return NULL;
@@ -157,6 +329,7 @@ void *stress_client_thread(void *arg) {
     }
 
     if (opcode == OP_LOGIN_RESP) {
+        hdr_record(&t->login_us, now_us() - start);
         if (payload) free(payload);
     } else {
         if (payload) free(payload);
@@ -165,32 +338,47 @@ void *stress_client_thread(void *arg) {
     }
 
     char dirs[] = {DIR_UP, DIR_DOWN, DIR_LEFT, DIR_RIGHT};
-    struct timeval start, end;
+    int failed = 0;
 
-    for (int i = 0; i < 50; i++) { // Run for a bit
-        char dir = dirs[rand() % 4];
+    for (uint32_t i = 0; i < 50 && !failed; i++) { // Run for a bit
+        MovePayload move;
+        move.direction = dirs[rand_r(&t->seed) % 4];
+        move.seq = i + 1;
         
-        gettimeofday(&start, NULL);
-        if (send_packet(sock, OP_MOVE, &dir, 1) < 0) {
+        start = now_us();
+        if (send_packet(sock, OP_MOVE, &move, sizeof(move)) < 0) {
             break;
         }
         
-        payload = NULL;
-        if (recv_packet(sock, &opcode, &payload, &len) < 0) {
+        // The first packet back gives the raw RTT; keep reading until an
+        // update acknowledges the move to get the tick-applied latency.
+        int first = 1;
+        int acked = 0;
+        while (!acked && !failed) {
+            payload = NULL;
+            if (recv_packet(sock, &opcode, &payload, &len) < 0) {
+                failed = 1;
+                break;
+            }
+            uint64_t elapsed = now_us() - start;
+
+            if (first) {
+                hdr_record(&t->rtt_us, elapsed);
+                t->requests++;
+                first = 0;
+            }
+            if (opcode == OP_UPDATE && len == sizeof(UpdateFrame)) {
+                UpdateFrame *frame = (UpdateFrame *)payload;
+                if (frame->header.ack_seq >= move.seq) {
+                    hdr_record(&t->tick_rtt_us, elapsed);
+                    acked = 1;
+                }
+            } else if (opcode == OP_DIE || opcode == OP_ERROR) {
+                failed = 1;
+            }
             if (payload) free(payload);
-            break;
         }
         
-        gettimeofday(&end, NULL);
-        long rtt = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
-        
-        pthread_mutex_lock(&stats_lock);
-        total_rtt += rtt;
-        total_requests++;
-        pthread_mutex_unlock(&stats_lock);
-
-        if (payload) free(payload);
-        
         usleep(100000); // 100ms
     }
 
@@ -198,14 +386,121 @@ void *stress_client_thread(void *arg) {
     return NULL;
 }
 
+void write_stress_csv(const char *path, StressThread *total, int clients, long connected, double elapsed_sec) {
+    FILE *f = fopen(path, "a");
+    if (!f) {
+        perror(path);
+        return;
+    }
+    // Header only for a new file so runs from different builds accumulate
+    if (ftell(f) == 0) {
+        fprintf(f, "timestamp,clients,connected,requests,elapsed_sec,throughput,"
+                   "metric,count,mean_us,p50_us,p90_us,p99_us,p999_us,max_us\n");
+    }
+
+    const char *names[] = { "connect", "login", "rtt", "tick_rtt" };
+    HdrHistogram *hists[] = { &total->connect_us, &total->login_us, &total->rtt_us, &total->tick_rtt_us };
+    for (int i = 0; i < 4; i++) {
+        HdrHistogram *h = hists[i];
+        fprintf(f, "%ld,%d,%ld,%ld,%.3f,%.2f,%s,%llu,%.1f,%llu,%llu,%llu,%llu,%llu\n",
+                (long)time(NULL), clients, connected, total->requests, elapsed_sec,
+                elapsed_sec > 0 ? total->requests / elapsed_sec : 0.0, names[i],
+                (unsigned long long)h->count, hdr_mean(h),
+                (unsigned long long)hdr_percentile(h, 50.0),
+                (unsigned long long)hdr_percentile(h, 90.0),
+                (unsigned long long)hdr_percentile(h, 99.0),
+                (unsigned long long)hdr_percentile(h, 99.9),
+                (unsigned long long)h->max);
+    }
+    fclose(f);
+}
+
+void write_stress_json(const char *path, StressThread *total, int clients, long connected, double elapsed_sec) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return;
+    }
+
+    fprintf(f, "{\n  \"timestamp\": %ld,\n  \"clients\": %d,\n  \"connected\": %ld,\n"
+               "  \"requests\": %ld,\n  \"elapsed_sec\": %.3f,\n  \"throughput\": %.2f",
+            (long)time(NULL), clients, connected, total->requests, elapsed_sec,
+            elapsed_sec > 0 ? total->requests / elapsed_sec : 0.0);
+
+    const char *names[] = { "connect_us", "login_us", "rtt_us", "tick_rtt_us" };
+    HdrHistogram *hists[] = { &total->connect_us, &total->login_us, &total->rtt_us, &total->tick_rtt_us };
+    for (int i = 0; i < 4; i++) {
+        HdrHistogram *h = hists[i];
+        fprintf(f, ",\n  \"%s\": {\"count\": %llu, \"mean\": %.1f, \"p50\": %llu, \"p90\": %llu, "
+                   "\"p99\": %llu, \"p999\": %llu, \"max\": %llu}",
+                names[i], (unsigned long long)h->count, hdr_mean(h),
+                (unsigned long long)hdr_percentile(h, 50.0),
+                (unsigned long long)hdr_percentile(h, 90.0),
+                (unsigned long long)hdr_percentile(h, 99.0),
+                (unsigned long long)hdr_percentile(h, 99.9),
+                (unsigned long long)h->max);
+    }
+    fprintf(f, "\n}\n");
+    fclose(f);
+}
+
+// Fetch and print the server's metrics (OP_STATS). Returns process exit code.
+int print_server_stats() {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in serv_addr;
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(PORT);
+    inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr);
+
+    if (connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
+        perror("connect");
+        close(sock);
+        return 1;
+    }
+
+    uint16_t opcode;
+    void *payload = NULL;
+    uint32_t len;
+
+    if (send_packet(sock, OP_STATS, NULL, 0) < 0 ||
+        recv_packet(sock, &opcode, &payload, &len) < 0 || opcode != OP_STATS_RESP) {
+        fprintf(stderr, "Failed to fetch stats.\n");
+        if (payload) free(payload);
+        close(sock);
+        return 1;
+    }
+
+    if (len == 0) fprintf(stderr, "Server sent no stats (too large for one packet).\n");
+    else fwrite(payload, 1, len, stdout);
+    free(payload);
+    close(sock);
+    return len > 0 ? 0 : 1;
+}
+
 int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "-stats") == 0) {
+        return print_server_stats();
+    }
+
+    if (argc > 1 && strcmp(argv[1], "-load") == 0) {
+        return run_load_generator(argc, argv);
+    }
+
     if (argc > 1 && strcmp(argv[1], "-stress") == 0) {
         stress_mode = 1;
         int num_threads = 100;
-        if (argc > 2) {
-            num_threads = atoi(argv[2]);
-            if (num_threads < 1) num_threads = 100;
-            if (num_threads > 500) num_threads = 500;
+        const char *csv_path = NULL;
+        const char *json_path = NULL;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "-csv") == 0 && i + 1 < argc) {
+                csv_path = argv[++i];
+            } else if (strcmp(argv[i], "-json") == 0 && i + 1 < argc) {
+                json_path = argv[++i];
+            } else {
+                num_threads = atoi(argv[i]);
+                if (num_threads < 1) num_threads = 100;
+                if (num_threads > 500) num_threads = 500;
+            }
         }
         
         printf("========================================\n");
@@ -214,13 +509,44 @@ int main(int argc, char *argv[]) {
         
         gettimeofday(&stress_start_time, NULL);
         
-        pthread_t *threads = malloc(sizeof(pthread_t) * num_threads);
+        StressThread *threads = malloc(sizeof(StressThread) * num_threads);
+        if (!threads) {
+            perror("malloc");
+            return 1;
+        }
         for (int i = 0; i < num_threads; i++) {
-            pthread_create(&threads[i], NULL, stress_client_thread, NULL);
+            StressThread *t = &threads[i];
+            t->seed = (unsigned int)time(NULL) ^ (unsigned int)(i * 2654435761u);
+            t->connected = 0;
+            t->requests = 0;
+            hdr_init(&t->connect_us);
+            hdr_init(&t->login_us);
+            hdr_init(&t->rtt_us);
+            hdr_init(&t->tick_rtt_us);
+            pthread_create(&t->thread, NULL, stress_client_thread, t);
             usleep(20000); // 20ms - stagger thread creation
         }
+
+        StressThread *total = malloc(sizeof(StressThread));
+        if (!total) {
+            perror("malloc");
+            return 1;
+        }
+        long successful_connections = 0;
+        total->requests = 0;
+        hdr_init(&total->connect_us);
+        hdr_init(&total->login_us);
+        hdr_init(&total->rtt_us);
+        hdr_init(&total->tick_rtt_us);
         for (int i = 0; i < num_threads; i++) {
-            pthread_join(threads[i], NULL);
+            StressThread *t = &threads[i];
+            pthread_join(t->thread, NULL);
+            successful_connections += t->connected;
+            total->requests += t->requests;
+            hdr_merge(&total->connect_us, &t->connect_us);
+            hdr_merge(&total->login_us, &t->login_us);
+            hdr_merge(&total->rtt_us, &t->rtt_us);
+            hdr_merge(&total->tick_rtt_us, &t->tick_rtt_us);
         }
         free(threads);
         
@@ -234,21 +560,47 @@ int main(int argc, char *argv[]) {
         printf("========================================\n");
         printf("  Concurrent Clients:    %d\n", num_threads);
         printf("  Successful Connections: %ld\n", successful_connections);
-        printf("  Total Requests:        %ld\n", total_requests);
+        printf("  Total Requests:        %ld\n", total->requests);
         printf("  Total Time:            %.2f seconds\n", elapsed_sec);
         
-        if (total_requests > 0) {
-            printf("  Avg Latency:           %ld us (%.2f ms)\n", 
-                   total_rtt / total_requests, 
-                   (double)(total_rtt / total_requests) / 1000.0);
+        if (total->requests > 0) {
+            printf("  Avg Latency:           %.0f us (%.2f ms)\n", 
+                   hdr_mean(&total->rtt_us), hdr_mean(&total->rtt_us) / 1000.0);
             printf("  Throughput:            %.2f requests/sec\n", 
-                   (double)total_requests / elapsed_sec);
+                   (double)total->requests / elapsed_sec);
         }
+        printf("----------------------------------------\n");
+        hdr_print_summary(&total->connect_us, "connect", "us", stdout);
+        hdr_print_summary(&total->login_us, "login", "us", stdout);
+        hdr_print_summary(&total->rtt_us, "rtt", "us", stdout);
+        hdr_print_summary(&total->tick_rtt_us, "tick_rtt", "us", stdout);
         printf("========================================\n");
+
+        if (csv_path) write_stress_csv(csv_path, total, num_threads, successful_connections, elapsed_sec);
+        if (json_path) write_stress_json(json_path, total, num_threads, successful_connections, elapsed_sec);
+        free(total);
         return 0;
     }
 
     // Normal Client
+    LoginRequest resume = { -1, 0 };
+    int use_udp = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-udp") == 0) {
+            use_udp = 1;
+        } else if (strcmp(argv[i], "-spectate") == 0) {
+            spectating = 1;
+        } else if (strcmp(argv[i], "-crc") == 0) {
+            proto_set_integrity(PROTO_CRC32C);
+        } else if (strcmp(argv[i], "-resume") == 0 && i + 1 < argc &&
+                   sscanf(argv[i + 1], "%d:%x", &resume.player_id, &resume.token) == 2) {
+            i++;
+        } else {
+            fprintf(stderr, "Usage: %s [-udp] [-crc] [-resume <id>:<token>] [-spectate]\n", argv[0]);
+            return 1;
+        }
+    }
+
     sockfd = socket(AF_INET, SOCK_STREAM, 0);
     struct sockaddr_in serv_addr;
     serv_addr.sin_family = AF_INET;
@@ -260,8 +612,10 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    // Login
-    send_packet(sockfd, OP_LOGIN_REQ, NULL, 0);
+    // Login, or take back a player the server restored from a checkpoint
+    if (spectating) send_packet(sockfd, OP_SPECTATE, NULL, 0);
+    else if (resume.player_id >= 0) send_packet(sockfd, OP_LOGIN_REQ, &resume, sizeof(resume));
+    else send_packet(sockfd, OP_LOGIN_REQ, NULL, 0);
     
     uint16_t opcode;
     void *payload = NULL;
@@ -274,9 +628,16 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    if (opcode == OP_LOGIN_RESP) {
+    if (opcode == OP_SPECTATE && spectating) {
+        printf("Spectating\n");
+        if (payload) free(payload);
+        use_udp = 0; // Spectators are served over TCP only
+    } else if (opcode == OP_LOGIN_RESP && !spectating) {
         my_id = *((int*)payload);
         printf("Logged in as Player %d\n", my_id);
+        if (len >= sizeof(LoginResponse)) {
+            my_token = ((LoginResponse *)payload)->token;
+        }
         free(payload);
     } else {
         printf("Login failed: %d\n", opcode);
@@ -285,15 +646,38 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    pthread_t t1, t2, t3;
+    if (use_udp) udp_open(&serv_addr);
+
+    if (render_init(&screen) < 0) {
+        perror("malloc");
+        close(sockfd);
+        return 1;
+    }
+    signal(SIGWINCH, handle_sigwinch);
+    predict_init(&predictor);
+
+    pthread_t t1, t2, t3, t4;
     pthread_create(&t1, NULL, input_thread_func, NULL);
     pthread_create(&t2, NULL, recv_thread_func, NULL);
     pthread_create(&t3, NULL, heartbeat_thread_func, NULL);
+    if (udp_fd >= 0) pthread_create(&t4, NULL, udp_recv_thread_func, NULL);
 
     pthread_join(t1, NULL);
     running = 0;  // Signal other threads to stop
     pthread_join(t2, NULL);
     pthread_join(t3, NULL);
+    if (udp_fd >= 0) pthread_join(t4, NULL);
+    render_close(&screen);
+    if (!spectating) {
+        printf("Prediction: %lu frames, %lu predicted ticks, %lu corrections (%.1f%%)\n",
+               predictor.frames, predictor.compared, predictor.corrections,
+               predictor.compared ? 100.0 * predictor.corrections / predictor.compared : 0.0);
+    }
+    if (udp_fd >= 0) {
+        printf("UDP: %lu updates, %lu late or duplicate, %lu lost\n",
+               udp_updates, udp_stale, udp_lost);
+        close(udp_fd);
+    }
 
     close(sockfd);
     return 0;
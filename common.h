@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <pthread.h>
 
+#include "metrics.h"
+
 // Game Constants
 #define MAP_WIDTH 40
 #define MAP_HEIGHT 40
@@ -31,10 +33,22 @@
 #define OP_DIE          0x0007
 #define OP_HEARTBEAT    0x0008  // Keep-alive heartbeat
 #define OP_HEARTBEAT_ACK 0x0009
+#define OP_STATS        0x000A  // Metrics request (no login required)
+#define OP_STATS_RESP   0x000B  // Metrics in Prometheus text format
+#define OP_UDP_REQ      0x000C  // Ask for the datagram channel (TCP, after login)
+#define OP_UDP_RESP     0x000D  // UdpResponse: the worker's UDP port, 0 if unavailable
+#define OP_UDP_HELLO    0x000E  // Datagram: binds the sender's address to the session
+#define OP_SPECTATE     0x000F  // Watch without a player slot; echoed back, then OP_UPDATE every tick
+#define OP_SCORES       0x0010  // ScoresPayload: pushed when the top of the leaderboard changes
+
+// Opcode flag: the header is an ExtendedHeader carrying a CRC32C of the
+// payload as sent, and the 16-bit checksum field is 0
+#define OP_FLAG_CRC32C  0x8000
 
 // Timeout Constants
 #define CLIENT_TIMEOUT_SEC  10  // Client timeout if no heartbeat
 #define HEARTBEAT_INTERVAL_SEC 3
+#define RESUME_GRACE_SEC    30  // How long restored players wait for their clients
 
 // Directions
 #define DIR_UP    'W'
@@ -68,14 +82,133 @@ typedef struct {
     uint16_t checksum;
 } __attribute__((packed)) PacketHeader;
 
+// Header of frames with OP_FLAG_CRC32C
+typedef struct {
+    PacketHeader base;
+    uint32_t crc32c;   // Of the encrypted payload, network byte order
+} __attribute__((packed)) ExtendedHeader;
+
+// OP_MOVE payload. Old clients may send only the direction byte (seq 0).
+typedef struct {
+    char direction;
+    uint32_t seq;      // Client move sequence number, echoed as ack_seq
+} __attribute__((packed)) MovePayload;
+
+// OP_LOGIN_REQ payload (optional): resume a player restored from a checkpoint
+typedef struct {
+    int32_t player_id;
+    uint32_t token;
+} LoginRequest;
+
+// OP_LOGIN_RESP payload. Old clients read only player_id.
+typedef struct {
+    int32_t player_id;
+    uint32_t token;    // Secret needed to resume this player after a server restart
+} LoginResponse;
+
+// OP_UPDATE payload
+typedef struct {
+    uint64_t tick;     // Game version this frame was taken at
+    uint32_t ack_seq;  // Latest move seq the game loop had applied to this player's snake
+    uint32_t reserved;
+} UpdateHeader;
+
+// The receiving player's own snake, so the client can predict its movement
+typedef struct {
+    uint16_t length;   // 0 if the player has no live snake
+    char direction;
+    uint8_t reserved;
+    uint8_t body[MAX_SNAKE_LENGTH][2]; // x, y; body[0] is the head
+} SnakeView;
+
+typedef struct {
+    UpdateHeader header;
+    SnakeView self;
+    int map[MAP_HEIGHT][MAP_WIDTH];
+} UpdateFrame;
+
+// OP_UDP_RESP payload
+typedef struct {
+    uint16_t port;     // Network byte order, 0 if the worker has no UDP socket
+    uint16_t reserved;
+} UdpResponse;
+
+// Prefix of every datagram payload (OP_UDP_HELLO, OP_MOVE, OP_UPDATE).
+// A datagram is one whole packet in the TCP framing (header + payload).
+typedef struct {
+    int32_t player_id;
+    uint32_t token;    // LoginResponse.token, authenticates the datagram
+    uint32_t seq;      // Per-direction datagram sequence; receivers drop seq <= last seen
+} UdpHeader;
+
+typedef struct {
+    UdpHeader udp;
+    UpdateFrame frame;
+} UdpUpdate;
+
+typedef struct {
+    UdpHeader udp;
+    MovePayload move;
+} __attribute__((packed)) UdpMove;
+
+// OP_SCORES payload: the header and `count` entries, best first
+#define LEADERBOARD_SIZE 10
+
+typedef struct {
+    int32_t player_id;
+    int32_t score;
+} ScoreEntry;
+
+typedef struct {
+    uint64_t version;  // Leaderboard.version this was taken at
+    uint32_t count;
+    uint32_t reserved;
+    ScoreEntry entries[LEADERBOARD_SIZE];
+} ScoresPayload;
+
+// Every active player ranked by score (see leaderboard.h)
+typedef struct {
+    int32_t count;
+    int32_t order[MAX_PLAYERS]; // Player ids, highest score first
+    int32_t pos[MAX_PLAYERS];   // Index in order + 1, 0 if not ranked
+    uint64_t version;           // Bumped when the top LEADERBOARD_SIZE changes
+} Leaderboard;
+
+// Spectator broadcast ring (see broadcast.h)
+#define BROADCAST_SLOTS 4
+#define BROADCAST_FRAME_SIZE (sizeof(PacketHeader) + sizeof(UpdateFrame))
+#define BROADCAST_CRC_FRAME_SIZE (sizeof(ExtendedHeader) + sizeof(UpdateFrame))
+
+typedef struct {
+    uint32_t seq;      // Seqlock: odd while the game loop rewrites the slot
+    uint32_t reserved;
+    uint64_t tick;
+    unsigned char data[BROADCAST_FRAME_SIZE]; // Encoded OP_UPDATE packet, no own snake
+} __attribute__((aligned(CACHE_LINE_SIZE))) BroadcastSlot;
+
+typedef struct {
+    uint64_t published; // Frames published; the newest is slots[(published - 1) % BROADCAST_SLOTS]
+    BroadcastSlot slots[BROADCAST_SLOTS];
+} BroadcastRing;
+
 // Shared Game State (Stored in Shared Memory)
 typedef struct {
     int map[MAP_HEIGHT][MAP_WIDTH];
     int scores[MAX_PLAYERS];
     int active_players[MAX_PLAYERS]; // 0 = inactive, 1 = active
+    int player_owner[MAX_PLAYERS];   // Worker slot serving each player
     Snake snakes[MAX_PLAYERS];
+    uint32_t move_seq[MAX_PLAYERS];    // Latest move seq received per player
+    uint32_t applied_seq[MAX_PLAYERS]; // move_seq as of the last tick that advanced the snake
+    uint32_t player_token[MAX_PLAYERS]; // Resume secret handed out at login
+    int detached[MAX_PLAYERS];         // Restored from a checkpoint, frozen until its client resumes
+    uint64_t resume_deadline;          // Unix time detached players are dropped, 0 if none
     uint64_t version;
+    uint64_t rng_state;      // World PRNG (game_rand), so food and spawns follow the seed
+    Leaderboard leaderboard; // Derived from scores and active_players, kept in step by game.c
     pthread_mutex_t lock;
+    ServerMetrics metrics; // Written without the lock, see metrics.h
+    BroadcastRing broadcast; // Written by the game loop, read by workers without the lock
 } GameState;
 
 #endif
@@ -0,0 +1,155 @@
+#include "crc32c.h"
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#define CRC32C_POLY 0x82F63B78 // Reflected Castagnoli polynomial
+
+static uint32_t table[8][256];   // Slicing-by-8
+static uint32_t x2n_table[32];   // x^(2^n) mod P, for combining
+static uint32_t (*crc32c_fn)(uint32_t, const void *, size_t) = crc32c_sw;
+static const char *impl_name = "slicing-by-8";
+
+uint32_t crc32c_sw(uint32_t crc, const void *data, size_t len) {
+    const unsigned char *p = data;
+    uint32_t c = ~crc;
+
+    while (len > 0 && ((uintptr_t)p & 7) != 0) {
+        c = table[0][(c ^ *p++) & 0xFF] ^ (c >> 8);
+        len--;
+    }
+    while (len >= 8) {
+        uint32_t lo = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+        uint32_t hi = (uint32_t)p[4] | (uint32_t)p[5] << 8 | (uint32_t)p[6] << 16 | (uint32_t)p[7] << 24;
+        lo ^= c;
+        c = table[7][lo & 0xFF] ^ table[6][(lo >> 8) & 0xFF] ^
+            table[5][(lo >> 16) & 0xFF] ^ table[4][lo >> 24] ^
+            table[3][hi & 0xFF] ^ table[2][(hi >> 8) & 0xFF] ^
+            table[1][(hi >> 16) & 0xFF] ^ table[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0) c = table[0][(c ^ *p++) & 0xFF] ^ (c >> 8);
+    return ~c;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const void *data, size_t len) {
+    const unsigned char *p = data;
+    uint64_t c = ~crc;
+
+    while (len > 0 && ((uintptr_t)p & 7) != 0) {
+        c = _mm_crc32_u8((uint32_t)c, *p++);
+        len--;
+    }
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        c = _mm_crc32_u64(c, v);
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0) c = _mm_crc32_u8((uint32_t)c, *p++);
+    return ~(uint32_t)c;
+}
+
+static int have_hw() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+}
+#define HW_NAME "sse4.2"
+#elif defined(__aarch64__)
+__attribute__((target("+crc")))
+static uint32_t crc32c_hw(uint32_t crc, const void *data, size_t len) {
+    const unsigned char *p = data;
+    uint32_t c = ~crc;
+
+    while (len > 0 && ((uintptr_t)p & 7) != 0) {
+        c = __crc32cb(c, *p++);
+        len--;
+    }
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        c = __crc32cd(c, v);
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0) c = __crc32cb(c, *p++);
+    return ~c;
+}
+
+static int have_hw() {
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+#define HW_NAME "armv8"
+#endif
+
+// a * b modulo P, both polynomials in reflected bit order
+static uint32_t multmodp(uint32_t a, uint32_t b) {
+    uint32_t m = (uint32_t)1 << 31, p = 0;
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) break;
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+    }
+    return p;
+}
+
+// Tables are built before main(), so every caller sees them finished
+__attribute__((constructor))
+static void crc32c_init() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = c & 1 ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+        table[0][i] = c;
+    }
+    for (int t = 1; t < 8; t++) {
+        for (int i = 0; i < 256; i++) table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xFF];
+    }
+
+    uint32_t p = (uint32_t)1 << 30; // x^1
+    x2n_table[0] = p;
+    for (int n = 1; n < 32; n++) x2n_table[n] = p = multmodp(p, p);
+
+#ifdef HW_NAME
+    if (have_hw()) {
+        crc32c_fn = crc32c_hw;
+        impl_name = HW_NAME;
+    }
+#endif
+}
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t len) {
+    return crc32c_fn(crc, data, len);
+}
+
+const char *crc32c_impl() {
+    return impl_name;
+}
+
+uint32_t crc32c_combine_op(size_t len2) {
+    uint32_t p = (uint32_t)1 << 31; // x^0
+    unsigned k = 3;                 // Bytes to bits
+    while (len2) {
+        if (len2 & 1) p = multmodp(x2n_table[k & 31], p);
+        len2 >>= 1;
+        k++;
+    }
+    return p;
+}
+
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, uint32_t op) {
+    return multmodp(op, crc1) ^ crc2;
+}
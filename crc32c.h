@@ -0,0 +1,27 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-32C (Castagnoli), the frame integrity check of the extended header
+// (see proto.h). Uses the SSE4.2 or ARMv8 CRC32C instructions when the CPU
+// has them, picked once at startup, and slicing-by-8 tables otherwise.
+// Like zlib's crc32(): start with crc = 0, and feed the result back in to
+// continue over more data.
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t len);
+
+// The table-driven version, always; for benchmarks and tests
+uint32_t crc32c_sw(uint32_t crc, const void *data, size_t len);
+
+// "sse4.2", "armv8" or "slicing-by-8"
+const char *crc32c_impl();
+
+// CRC of A followed by B from crc(A), crc(B) and len(B), without touching
+// the data. crc32c_combine_op(len) depends only on the length, so callers
+// appending blocks of a fixed size compute it once.
+uint32_t crc32c_combine_op(size_t len2);
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, uint32_t op);
+
+#endif
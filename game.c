@@ -0,0 +1,221 @@
+#include "game.h"
+#include "leaderboard.h"
+#include <stddef.h>
+
+uint32_t game_rand(GameState *gs) {
+    uint64_t z = (gs->rng_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return (uint32_t)((z ^ (z >> 31)) >> 32);
+}
+
+void game_init(GameState *gs, uint64_t seed) {
+    gs->rng_state = seed;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        gs->player_owner[i] = -1;
+    }
+
+    // Initialize Map
+    for (int y = 0; y < MAP_HEIGHT; y++) {
+        for (int x = 0; x < MAP_WIDTH; x++) {
+            if (x == 0 || x == MAP_WIDTH - 1 || y == 0 || y == MAP_HEIGHT - 1) {
+                gs->map[y][x] = CELL_WALL;
+            } else {
+                gs->map[y][x] = CELL_EMPTY;
+            }
+        }
+    }
+
+    // Place some initial food
+    for (int i = 0; i < 20; i++) {
+        int rx = game_rand(gs) % (MAP_WIDTH - 2) + 1;
+        int ry = game_rand(gs) % (MAP_HEIGHT - 2) + 1;
+        gs->map[ry][rx] = CELL_FOOD;
+    }
+}
+
+void game_spawn_food(GameState *gs) {
+    int placed = 0;
+    while (!placed) {
+        int rx = game_rand(gs) % (MAP_WIDTH - 2) + 1;
+        int ry = game_rand(gs) % (MAP_HEIGHT - 2) + 1;
+        if (gs->map[ry][rx] == CELL_EMPTY) {
+            gs->map[ry][rx] = CELL_FOOD;
+            placed = 1;
+        }
+    }
+}
+
+int game_add_player(GameState *gs, int owner) {
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (!gs->active_players[i]) {
+            gs->active_players[i] = 1;
+            gs->player_owner[i] = owner;
+            gs->scores[i] = 0;
+            gs->move_seq[i] = 0;
+            gs->applied_seq[i] = 0;
+            gs->player_token[i] = game_rand(gs);
+            gs->detached[i] = 0;
+
+            // Initialize Snake
+            gs->snakes[i].length = 1;
+            gs->snakes[i].alive = 1;
+            gs->snakes[i].direction = DIR_RIGHT; // Default
+
+            // Spawn player
+            int placed = 0;
+            while (!placed) {
+                int rx = game_rand(gs) % (MAP_WIDTH - 2) + 1;
+                int ry = game_rand(gs) % (MAP_HEIGHT - 2) + 1;
+                if (gs->map[ry][rx] == CELL_EMPTY) {
+                    gs->map[ry][rx] = CELL_PLAYER_BASE + i;
+                    gs->snakes[i].body[0].x = rx;
+                    gs->snakes[i].body[0].y = ry;
+                    placed = 1;
+                }
+            }
+            leaderboard_add(gs, i);
+            return i;
+        }
+    }
+    return -1;
+}
+
+int game_resume_player(GameState *gs, int player_id, uint32_t token, int owner) {
+    if (player_id < 0 || player_id >= MAX_PLAYERS) return -1;
+    if (!gs->active_players[player_id] || !gs->detached[player_id]) return -1;
+    if (gs->player_token[player_id] != token) return -1;
+    gs->detached[player_id] = 0;
+    gs->player_owner[player_id] = owner;
+    return player_id;
+}
+
+void game_remove_player(GameState *gs, int player_id) {
+    leaderboard_remove(gs, player_id);
+    gs->active_players[player_id] = 0;
+    gs->detached[player_id] = 0;
+    gs->player_owner[player_id] = -1;
+    for (int y = 0; y < MAP_HEIGHT; y++) {
+        for (int x = 0; x < MAP_WIDTH; x++) {
+            if (gs->map[y][x] == CELL_PLAYER_BASE + player_id) {
+                gs->map[y][x] = CELL_EMPTY;
+            }
+        }
+    }
+}
+
+int game_move(GameState *gs, int player_id, char dir, uint32_t seq) {
+    if (!gs->active_players[player_id] || !gs->snakes[player_id].alive) return 0;
+
+    // Acknowledged in the update of the tick that processes it
+    if (seq != 0) gs->move_seq[player_id] = seq;
+
+    // Prevent 180 turn
+    char current = gs->snakes[player_id].direction;
+    if ((current == DIR_UP && dir == DIR_DOWN) ||
+        (current == DIR_DOWN && dir == DIR_UP) ||
+        (current == DIR_LEFT && dir == DIR_RIGHT) ||
+        (current == DIR_RIGHT && dir == DIR_LEFT)) {
+        return 0;
+    }
+    gs->snakes[player_id].direction = dir;
+    return 1;
+}
+
+void game_tick(GameState *gs, TickResult *result) {
+    result->alive = 0;
+    result->num_deaths = 0;
+
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (gs->active_players[i] && gs->snakes[i].alive && !gs->detached[i]) {
+            Snake *s = &gs->snakes[i];
+            Point head = s->body[0];
+            Point new_head = head;
+            gs->applied_seq[i] = gs->move_seq[i];
+
+            if (s->direction == DIR_UP) new_head.y--;
+            else if (s->direction == DIR_DOWN) new_head.y++;
+            else if (s->direction == DIR_LEFT) new_head.x--;
+            else if (s->direction == DIR_RIGHT) new_head.x++;
+
+            // Check collisions
+            int collision = 0;
+            if (gs->map[new_head.y][new_head.x] == CELL_WALL) collision = 1;
+            else if (gs->map[new_head.y][new_head.x] >= CELL_PLAYER_BASE) {
+                 // Hit self or other
+                 collision = 1;
+            }
+
+            if (collision) {
+                // Die
+                s->alive = 0;
+                gs->active_players[i] = 0; // Mark inactive so workers know
+                leaderboard_remove(gs, i);
+                // Clear body
+                for (int j = 0; j < s->length; j++) {
+                    gs->map[s->body[j].y][s->body[j].x] = CELL_EMPTY;
+                }
+                result->deaths[result->num_deaths++] = i;
+            } else {
+                result->alive++;
+                int grow = 0;
+                if (gs->map[new_head.y][new_head.x] == CELL_FOOD) {
+                    grow = 1;
+                    gs->scores[i]++;
+                    leaderboard_score(gs, i);
+                    game_spawn_food(gs);
+                }
+
+                // Move Body
+                // If not growing, clear tail
+                if (!grow) {
+                    Point tail = s->body[s->length - 1];
+                    gs->map[tail.y][tail.x] = CELL_EMPTY;
+                } else {
+                    if (s->length < MAX_SNAKE_LENGTH) {
+                        s->length++;
+                    }
+                }
+
+                // Shift body segments
+                for (int j = s->length - 1; j > 0; j--) {
+                    s->body[j] = s->body[j - 1];
+                }
+                s->body[0] = new_head;
+                gs->map[new_head.y][new_head.x] = CELL_PLAYER_BASE + i;
+            }
+        }
+    }
+
+    gs->version++;
+}
+
+// FNV-1a over 32-bit words
+static uint64_t hash_words(uint64_t h, const void *data, size_t len) {
+    const uint32_t *w = data;
+    for (size_t i = 0; i < len / 4; i++) {
+        h ^= w[i];
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+uint64_t game_hash(const GameState *gs) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    h = hash_words(h, gs->map, sizeof(gs->map));
+    h = hash_words(h, gs->scores, sizeof(gs->scores));
+    h = hash_words(h, gs->active_players, sizeof(gs->active_players));
+    h = hash_words(h, gs->applied_seq, sizeof(gs->applied_seq));
+    // Field by field: Snake has padding, and only the live body matters
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        const Snake *s = &gs->snakes[i];
+        uint32_t fields[3] = { (uint32_t)s->length, (uint32_t)s->direction, (uint32_t)s->alive };
+        h = hash_words(h, fields, sizeof(fields));
+        if (s->length > 0 && s->length <= MAX_SNAKE_LENGTH) {
+            h = hash_words(h, s->body, s->length * sizeof(Point));
+        }
+    }
+    h = hash_words(h, &gs->version, sizeof(gs->version));
+    h = hash_words(h, &gs->rng_state, sizeof(gs->rng_state));
+    return h;
+}
@@ -0,0 +1,46 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include "common.h"
+
+// Game simulation on a GameState. None of these functions lock;
+// callers sharing the state must hold game_state->lock.
+// The simulation is deterministic: all randomness comes from the world's own
+// PRNG, so the same seed and the same inputs produce the same worlds.
+
+typedef struct {
+    int alive;                // Snakes still alive after the tick
+    int num_deaths;
+    int deaths[MAX_PLAYERS];  // Player ids that died this tick
+} TickResult;
+
+// Seeds the PRNG, builds walls and places initial food.
+// Does not touch the mutex or metrics.
+void game_init(GameState *gs, uint64_t seed);
+
+// Next value of the world PRNG (splitmix64)
+uint32_t game_rand(GameState *gs);
+
+void game_spawn_food(GameState *gs);
+
+// Claims a free slot, places a length-1 snake and draws its resume token.
+// Returns the player id, or -1 if full.
+int game_add_player(GameState *gs, int owner);
+
+// Reattaches a detached (checkpoint-restored) player whose token matches.
+// Returns the player id, or -1.
+int game_resume_player(GameState *gs, int player_id, uint32_t token, int owner);
+
+void game_remove_player(GameState *gs, int player_id);
+
+// Turns a live snake (180 degree turns are ignored) and records the move seq.
+// Returns 1 if the direction changed.
+int game_move(GameState *gs, int player_id, char dir, uint32_t seq);
+
+// Advances every live, attached snake by one cell and bumps the version
+void game_tick(GameState *gs, TickResult *result);
+
+// Hash of everything the simulation reads, for comparing two runs
+uint64_t game_hash(const GameState *gs);
+
+#endif
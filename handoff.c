@@ -0,0 +1,71 @@
+#include "handoff.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+int handoff_send(int sock, const HandoffMsg *msg, int fd) {
+    struct iovec iov = { (void *)msg, sizeof(*msg) };
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+
+    if (fd >= 0) {
+        memset(&control, 0, sizeof(control));
+        mh.msg_control = control.buf;
+        mh.msg_controllen = sizeof(control.buf);
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cm), &fd, sizeof(int));
+    }
+
+    ssize_t n;
+    do {
+        n = sendmsg(sock, &mh, MSG_NOSIGNAL);
+    } while (n == -1 && errno == EINTR);
+    if (n != (ssize_t)sizeof(*msg)) {
+        perror("handoff sendmsg");
+        return -1;
+    }
+    return 0;
+}
+
+int handoff_recv(int sock, HandoffMsg *msg, int *fd) {
+    struct iovec iov = { msg, sizeof(*msg) };
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof(control.buf);
+
+    *fd = -1;
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &mh, MSG_WAITALL);
+    } while (n == -1 && errno == EINTR);
+    if (n != (ssize_t)sizeof(*msg)) {
+        if (n == -1) perror("handoff recvmsg");
+        return -1;
+    }
+
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&mh); cm != NULL; cm = CMSG_NXTHDR(&mh, cm)) {
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS) {
+            memcpy(fd, CMSG_DATA(cm), sizeof(int));
+        }
+    }
+    return 0;
+}
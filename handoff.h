@@ -0,0 +1,43 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <stdint.h>
+
+// Hot upgrade: the running master passes the listening socket, the shared
+// world segment and every live client connection to a newly exec'd master.
+// Messages are fixed-size and carry at most one fd (SCM_RIGHTS) each.
+//
+// Old master                          New master (./server -upgrade <path>)
+//   listens on <path>, execs new  -->   connects
+//   HANDOFF_LISTENER (listen fd)  -->   attaches shmid, keeps listen fd
+//   stops game loop, then per worker:
+//     worker sends its clients to the old master, which relays them
+//   HANDOFF_CLIENT (client fd)... -->   queues fds by worker slot
+//   HANDOFF_DONE, exits without   -->   forks workers with their clients
+//   removing shared memory              and a new game loop
+
+#define HANDOFF_LISTENER 1 // fd = listening socket, shmid set
+#define HANDOFF_CLIENT   2 // fd = client connection
+#define HANDOFF_DONE     3 // No fd; sender is finished
+#define HANDOFF_START    4 // No fd; master asks a worker to hand over its clients
+
+#define HANDOFF_SOCKET_PATH "/tmp/snake_upgrade.sock"
+#define HANDOFF_ACCEPT_TIMEOUT_SEC 10 // How long the old master waits for the new one
+
+typedef struct {
+    uint32_t type;
+    int32_t worker;        // Worker slot that served the client
+    int32_t player_id;     // -1 if the connection never logged in
+    int32_t arg;           // HANDOFF_LISTENER: shmid. HANDOFF_CLIENT: PROTO_* the client uses (-1 from older masters)
+    uint64_t version;      // Last game version sent to the client
+    int64_t last_activity; // Unix time of the client's last packet
+} HandoffMsg;
+
+// Sends msg with fd attached (fd -1 for none). Returns 0 or -1.
+int handoff_send(int sock, const HandoffMsg *msg, int fd);
+
+// Receives one message; *fd is the attached descriptor or -1.
+// Returns 0, or -1 on error or EOF.
+int handoff_recv(int sock, HandoffMsg *msg, int *fd);
+
+#endif
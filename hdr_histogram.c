@@ -0,0 +1,76 @@
+#include "hdr_histogram.h"
+#include <string.h>
+
+#define HDR_HALF (HDR_SUB_BUCKETS / 2)
+#define HDR_SUB_BITS 6 // log2(HDR_SUB_BUCKETS)
+
+static int bucket_index(uint64_t value) {
+    if (value < HDR_SUB_BUCKETS) return (int)value;
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - (HDR_SUB_BITS - 1); // value >> shift lands in [HALF, SUB)
+    if (shift > HDR_MAX_SHIFT) return HDR_NUM_BUCKETS - 1;
+    return HDR_SUB_BUCKETS + (shift - 1) * HDR_HALF + (int)((value >> shift) - HDR_HALF);
+}
+
+static uint64_t bucket_highest(int index) {
+    if (index < HDR_SUB_BUCKETS) return (uint64_t)index;
+    int k = index - HDR_SUB_BUCKETS;
+    int shift = k / HDR_HALF + 1;
+    uint64_t lowest = (uint64_t)(k % HDR_HALF + HDR_HALF) << shift;
+    return lowest + (1ULL << shift) - 1;
+}
+
+void hdr_init(HdrHistogram *h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+void hdr_record(HdrHistogram *h, uint64_t value) {
+    h->buckets[bucket_index(value)]++;
+    h->count++;
+    h->sum += value;
+    if (value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+}
+
+void hdr_merge(HdrHistogram *dst, const HdrHistogram *src) {
+    for (int i = 0; i < HDR_NUM_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+uint64_t hdr_percentile(const HdrHistogram *h, double percentile) {
+    if (h->count == 0) return 0;
+    if (percentile >= 100.0) return h->max;
+
+    uint64_t target = (uint64_t)(h->count * percentile / 100.0 + 0.5);
+    if (target == 0) target = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HDR_NUM_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= target) {
+            uint64_t v = bucket_highest(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+double hdr_mean(const HdrHistogram *h) {
+    return h->count ? (double)h->sum / h->count : 0.0;
+}
+
+void hdr_print_summary(const HdrHistogram *h, const char *name, const char *unit, FILE *out) {
+    fprintf(out, "  %-12s n=%-8llu mean=%-9.0f p50=%-8llu p90=%-8llu p99=%-8llu p99.9=%-8llu max=%llu %s\n",
+            name, (unsigned long long)h->count, hdr_mean(h),
+            (unsigned long long)hdr_percentile(h, 50.0),
+            (unsigned long long)hdr_percentile(h, 90.0),
+            (unsigned long long)hdr_percentile(h, 99.0),
+            (unsigned long long)hdr_percentile(h, 99.9),
+            (unsigned long long)h->max, unit);
+}
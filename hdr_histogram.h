@@ -0,0 +1,36 @@
+#ifndef HDR_HISTOGRAM_H
+#define HDR_HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Log-linear (HDR-style) histogram for latency values, e.g. microseconds.
+// Values below HDR_SUB_BUCKETS are exact; above that every power of two is
+// split into HDR_SUB_BUCKETS / 2 linear buckets, so the relative error of a
+// reported percentile is below 2 / HDR_SUB_BUCKETS (~3%).
+// A histogram has a single writer; merge per-thread histograms at the end.
+
+#define HDR_SUB_BUCKETS 64
+#define HDR_MAX_SHIFT   36 // Values up to 2^42 are tracked, larger ones clamp
+#define HDR_NUM_BUCKETS (HDR_SUB_BUCKETS + HDR_MAX_SHIFT * (HDR_SUB_BUCKETS / 2))
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[HDR_NUM_BUCKETS];
+} HdrHistogram;
+
+void hdr_init(HdrHistogram *h);
+void hdr_record(HdrHistogram *h, uint64_t value);
+void hdr_merge(HdrHistogram *dst, const HdrHistogram *src);
+
+// Value at the given percentile (0-100), the highest value equivalent to its bucket
+uint64_t hdr_percentile(const HdrHistogram *h, double percentile);
+double hdr_mean(const HdrHistogram *h);
+
+// One line: count, mean, p50, p90, p99, p99.9, max
+void hdr_print_summary(const HdrHistogram *h, const char *name, const char *unit, FILE *out);
+
+#endif
@@ -0,0 +1,98 @@
+#include "leaderboard.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+static void place(Leaderboard *lb, int index, int player_id) {
+    lb->order[index] = player_id;
+    lb->pos[player_id] = index + 1;
+}
+
+// First index in [lo, hi) whose score is <= score, or hi
+static int first_at_most(const GameState *gs, int lo, int hi, int score) {
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (gs->scores[gs->leaderboard.order[mid]] > score) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+void leaderboard_add(GameState *gs, int player_id) {
+    Leaderboard *lb = &gs->leaderboard;
+    if (lb->pos[player_id] != 0) return;
+    place(lb, lb->count++, player_id);
+    if (lb->count <= LEADERBOARD_SIZE) lb->version++;
+}
+
+void leaderboard_score(GameState *gs, int player_id) {
+    Leaderboard *lb = &gs->leaderboard;
+    int index = lb->pos[player_id] - 1;
+    if (index < 0) return;
+
+    // Swap with the first player still on the old score
+    int first = first_at_most(gs, 0, index, gs->scores[player_id] - 1);
+    place(lb, index, lb->order[first]);
+    place(lb, first, player_id);
+    if (first < LEADERBOARD_SIZE) lb->version++;
+}
+
+void leaderboard_remove(GameState *gs, int player_id) {
+    Leaderboard *lb = &gs->leaderboard;
+    int index = lb->pos[player_id] - 1;
+    if (index < 0) return;
+    if (index < LEADERBOARD_SIZE) lb->version++;
+
+    // Move the player to the end one score group at a time: swapping it with
+    // the last player of its group and then of each lower group keeps the
+    // rest in order
+    int score = gs->scores[player_id];
+    while (index < lb->count - 1) {
+        int last = first_at_most(gs, index + 1, lb->count, score - 1) - 1;
+        if (last == index) {
+            // Last of its group: continue into the next one down
+            last = index + 1;
+            score = gs->scores[lb->order[last]];
+            last = first_at_most(gs, last, lb->count, score - 1) - 1;
+        }
+        place(lb, index, lb->order[last]);
+        place(lb, last, player_id);
+        index = last;
+    }
+    lb->count--;
+    lb->pos[player_id] = 0;
+}
+
+static const GameState *sort_state;
+
+static int by_score(const void *a, const void *b) {
+    int pa = *(const int32_t *)a, pb = *(const int32_t *)b;
+    int sa = sort_state->scores[pa], sb = sort_state->scores[pb];
+    if (sa != sb) return sa > sb ? -1 : 1;
+    return pa - pb;
+}
+
+void leaderboard_rebuild(GameState *gs) {
+    Leaderboard *lb = &gs->leaderboard;
+    lb->count = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        lb->pos[i] = 0;
+        if (gs->active_players[i]) lb->order[lb->count++] = i;
+    }
+    sort_state = gs;
+    qsort(lb->order, lb->count, sizeof(lb->order[0]), by_score);
+    for (int i = 0; i < lb->count; i++) lb->pos[lb->order[i]] = i + 1;
+    lb->version++;
+}
+
+uint32_t leaderboard_snapshot(const GameState *gs, ScoresPayload *out) {
+    const Leaderboard *lb = &gs->leaderboard;
+    out->version = lb->version;
+    out->count = lb->count < LEADERBOARD_SIZE ? lb->count : LEADERBOARD_SIZE;
+    out->reserved = 0;
+    for (uint32_t i = 0; i < out->count; i++) {
+        out->entries[i].player_id = lb->order[i];
+        out->entries[i].score = gs->scores[lb->order[i]];
+    }
+    return offsetof(ScoresPayload, entries) + out->count * sizeof(ScoreEntry);
+}
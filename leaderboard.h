@@ -0,0 +1,27 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include "common.h"
+
+// Ranking of the active players by score (gs->leaderboard), kept sorted as
+// the game changes it rather than sorted on demand. Scores only ever grow by
+// one, so a score change is a binary search and a swap; a removal walks the
+// player past each lower score group. Neither depends on the player count.
+// Like game.h, callers sharing the state must hold game_state->lock.
+
+// New player, score 0: ranked last
+void leaderboard_add(GameState *gs, int player_id);
+
+// Call after gs->scores[player_id] went up by one
+void leaderboard_score(GameState *gs, int player_id);
+
+// Death, logout or disconnect. No-op if the player is not ranked.
+void leaderboard_remove(GameState *gs, int player_id);
+
+// Ranks every active player from scratch (checkpoint restore, lock recovery)
+void leaderboard_rebuild(GameState *gs);
+
+// Fills the top entries. Returns the OP_SCORES payload length.
+uint32_t leaderboard_snapshot(const GameState *gs, ScoresPayload *out);
+
+#endif
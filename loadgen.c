@@ -0,0 +1,729 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+#include "common.h"
+#include "proto.h"
+#include "hdr_histogram.h"
+#include "loadgen.h"
+
+#define LOAD_PHASE_RAMP   0
+#define LOAD_PHASE_STEADY 1
+#define LOAD_PHASE_DRAIN  2 // Moves stop, connections stay up to collect in-flight acks
+#define LOAD_PHASES       3
+#define LOAD_PHASE_DONE   3
+
+#define CONN_IDLE       0 // Not connected, reconnects at retry_at
+#define CONN_CONNECTING 1
+#define CONN_LOGIN      2 // OP_LOGIN_REQ sent
+#define CONN_ACTIVE     3
+#define CONN_SILENT     4 // Churned: sends nothing until the server times it out
+#define CONN_DONE       5 // Never reconnects
+#define CONN_WATCHING   6 // Spectator: OP_SPECTATE answered, receives frames only
+
+#define CHURN_LOGOUT 0
+#define CHURN_DROP   1
+#define CHURN_SILENT 2
+#define CHURN_MIXED  3
+
+#define SEQ_WINDOW       64     // Unacked moves we keep send times for
+#define RBUF_SIZE        8192   // Fits one UpdateFrame
+#define WBUF_SIZE        64
+#define RETRY_DELAY_US   1000000
+#define CHURN_RECONNECT_US 100000
+#define SCAN_INTERVAL_US 100000 // Heartbeats and reconnects
+#define MAX_EVENTS       256
+
+typedef struct {
+    const char *host;
+    int connections;
+    int spectators;    // Extra connections that watch (OP_SPECTATE) instead of playing
+    int threads;
+    double move_rate;  // Target moves/sec across all logged-in connections
+    int ramp_sec;
+    int duration_sec;  // Steady phase
+    int drain_sec;
+    double churn_rate; // Churn events/sec across all connections
+    int churn_mode;
+} LoadConfig;
+
+typedef struct {
+    double moves_due;       // Moves the open-loop schedule called for
+    uint64_t moves_sent;
+    uint64_t moves_skipped; // Due but not sent: socket buffer full or schedule backlog
+    uint64_t connects;
+    uint64_t connect_failures;
+    uint64_t logins;
+    uint64_t login_rejects;
+    uint64_t heartbeats;
+    uint64_t updates;
+    uint64_t spectates;         // Spectator connections accepted
+    uint64_t spectator_updates;
+    uint64_t scores;            // OP_SCORES received
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t deaths;
+    uint64_t server_closes; // Includes server timeouts of silent connections
+    uint64_t churn[3];
+    uint64_t errors;
+    HdrHistogram connect_us;
+    HdrHistogram login_us;
+    HdrHistogram ack_us;    // Move sent -> OP_UPDATE whose ack_seq covers it
+} PhaseStats;
+
+typedef struct {
+    int fd;
+    int state;
+    int spectator;
+    uint64_t state_since;
+    uint64_t retry_at;
+    uint64_t last_send;
+    uint32_t next_seq;
+    uint32_t acked_seq;
+    uint64_t sent_at[SEQ_WINDOW];
+    size_t rlen;
+    size_t wlen;
+    unsigned char wbuf[WBUF_SIZE];
+    unsigned char rbuf[RBUF_SIZE];
+} LoadConn;
+
+typedef struct {
+    pthread_t thread;
+    int epfd;
+    LoadConn *conns;
+    int nconns;
+    int opened;   // Connections started so far by the ramp
+    int active;   // Connections in CONN_ACTIVE
+    int cursor;   // Round-robin position for moves
+    unsigned int seed;
+    double move_credit;
+    double churn_credit;
+    uint64_t next_scan;
+    PhaseStats phases[LOAD_PHASES];
+} LoadThread;
+
+static const char *phase_names[LOAD_PHASES] = { "ramp", "steady", "drain" };
+
+static LoadConfig cfg;
+static struct sockaddr_in server_addr;
+static int load_phase = LOAD_PHASE_RAMP;
+static uint64_t load_start_us;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static int current_phase(void) {
+    return __atomic_load_n(&load_phase, __ATOMIC_ACQUIRE);
+}
+
+static void set_state(LoadThread *t, LoadConn *c, int state, uint64_t now) {
+    if (c->state == CONN_ACTIVE) t->active--;
+    if (state == CONN_ACTIVE) t->active++;
+    c->state = state;
+    c->state_since = now;
+}
+
+static void conn_close(LoadThread *t, LoadConn *c, uint64_t now, uint64_t retry_delay) {
+    if (c->fd >= 0) {
+        close(c->fd); // Also removes it from the epoll set
+        c->fd = -1;
+    }
+    c->rlen = 0;
+    c->wlen = 0;
+    c->retry_at = now + retry_delay;
+    set_state(t, c, current_phase() >= LOAD_PHASE_DRAIN ? CONN_DONE : CONN_IDLE, now);
+}
+
+static void watch_output(LoadThread *t, LoadConn *c, int enable) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (enable ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+    epoll_ctl(t->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+// Returns 0 if sent or queued, -1 if the connection still has a partial frame queued
+// (caller drops the packet), -2 if the connection failed.
+static int conn_send(LoadThread *t, LoadConn *c, PhaseStats *ps, uint16_t opcode,
+                     const void *payload, uint32_t len, uint64_t now) {
+    if (c->wlen > 0) return -1;
+
+    unsigned char frame[WBUF_SIZE];
+    int flen = encode_packet(frame, sizeof(frame), opcode, payload, len);
+    if (flen < 0) return -2;
+
+    ssize_t n = send(c->fd, frame, flen, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) return -2;
+        n = 0;
+    }
+    ps->bytes_out += n;
+    c->last_send = now;
+
+    if (n < flen) {
+        memcpy(c->wbuf, frame + n, flen - n);
+        c->wlen = flen - n;
+        watch_output(t, c, 1);
+    }
+    return 0;
+}
+
+static void start_connect(LoadThread *t, LoadConn *c, PhaseStats *ps, uint64_t now) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        ps->errors++;
+        c->retry_at = now + RETRY_DELAY_US;
+        return;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (connect(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0 && errno != EINPROGRESS) {
+        ps->connect_failures++;
+        close(fd);
+        c->retry_at = now + RETRY_DELAY_US;
+        return;
+    }
+
+    c->fd = fd;
+    c->rlen = 0;
+    c->wlen = 0;
+    set_state(t, c, CONN_CONNECTING, now);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.ptr = c;
+    epoll_ctl(t->epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void handle_connected(LoadThread *t, LoadConn *c, PhaseStats *ps, uint64_t now) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    if (err != 0) {
+        ps->connect_failures++;
+        conn_close(t, c, now, RETRY_DELAY_US);
+        return;
+    }
+
+    ps->connects++;
+    hdr_record(&ps->connect_us, now - c->state_since);
+    watch_output(t, c, 0);
+
+    set_state(t, c, CONN_LOGIN, now);
+    if (conn_send(t, c, ps, c->spectator ? OP_SPECTATE : OP_LOGIN_REQ, NULL, 0, now) != 0) {
+        ps->errors++;
+        conn_close(t, c, now, RETRY_DELAY_US);
+    }
+}
+
+static void handle_frame(LoadThread *t, LoadConn *c, PhaseStats *ps, uint16_t opcode,
+                         unsigned char *payload, uint32_t len, uint64_t now) {
+    if (opcode == OP_LOGIN_RESP && c->state == CONN_LOGIN) {
+        ps->logins++;
+        hdr_record(&ps->login_us, now - c->state_since);
+        c->next_seq = 0;
+        c->acked_seq = 0;
+        set_state(t, c, CONN_ACTIVE, now);
+    } else if (opcode == OP_SPECTATE && c->state == CONN_LOGIN) {
+        ps->spectates++;
+        set_state(t, c, CONN_WATCHING, now);
+    } else if (opcode == OP_ERROR && c->state == CONN_LOGIN) {
+        ps->login_rejects++; // Server full
+        conn_close(t, c, now, RETRY_DELAY_US);
+    } else if (opcode == OP_UPDATE && c->spectator) {
+        ps->spectator_updates++;
+    } else if (opcode == OP_UPDATE) {
+        ps->updates++;
+        if (len == sizeof(UpdateFrame)) {
+            UpdateHeader hdr;
+            memcpy(&hdr, payload, sizeof(hdr));
+            // Every move up to ack_seq was applied by this frame's tick
+            while (c->acked_seq < hdr.ack_seq && c->acked_seq < c->next_seq) {
+                c->acked_seq++;
+                if (c->next_seq - c->acked_seq < SEQ_WINDOW) {
+                    hdr_record(&ps->ack_us, now - c->sent_at[c->acked_seq % SEQ_WINDOW]);
+                }
+            }
+        }
+    } else if (opcode == OP_SCORES) {
+        ps->scores++;
+    } else if (opcode == OP_DIE) {
+        ps->deaths++;
+        conn_close(t, c, now, CHURN_RECONNECT_US);
+    }
+}
+
+static void handle_readable(LoadThread *t, LoadConn *c, PhaseStats *ps, uint64_t now) {
+    while (c->fd >= 0) {
+        ssize_t n = recv(c->fd, c->rbuf + c->rlen, RBUF_SIZE - c->rlen, MSG_DONTWAIT);
+        if (n == 0) {
+            ps->server_closes++;
+            conn_close(t, c, now, RETRY_DELAY_US);
+            return;
+        }
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return;
+            ps->errors++;
+            conn_close(t, c, now, RETRY_DELAY_US);
+            return;
+        }
+        ps->bytes_in += n;
+        c->rlen += n;
+
+        size_t off = 0;
+        while (c->fd >= 0) {
+            uint16_t opcode;
+            unsigned char *payload;
+            uint32_t plen;
+            int used = decode_packet(c->rbuf + off, c->rlen - off, &opcode, &payload, &plen);
+            if (used == 0) break;
+            if (used < 0) {
+                ps->errors++;
+                conn_close(t, c, now, RETRY_DELAY_US);
+                return;
+            }
+            handle_frame(t, c, ps, opcode, payload, plen, now);
+            off += used;
+        }
+        if (c->fd < 0) return;
+
+        if (off > 0) {
+            memmove(c->rbuf, c->rbuf + off, c->rlen - off);
+            c->rlen -= off;
+        }
+        if (c->rlen == RBUF_SIZE) {
+            // A single frame larger than the buffer
+            ps->errors++;
+            conn_close(t, c, now, RETRY_DELAY_US);
+            return;
+        }
+    }
+}
+
+static void handle_writable(LoadThread *t, LoadConn *c, PhaseStats *ps, uint64_t now) {
+    if (c->state == CONN_CONNECTING) {
+        handle_connected(t, c, ps, now);
+        return;
+    }
+    if (c->wlen == 0) {
+        watch_output(t, c, 0);
+        return;
+    }
+
+    ssize_t n = send(c->fd, c->wbuf, c->wlen, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+        ps->errors++;
+        conn_close(t, c, now, RETRY_DELAY_US);
+        return;
+    }
+    ps->bytes_out += n;
+    memmove(c->wbuf, c->wbuf + n, c->wlen - n);
+    c->wlen -= n;
+    if (c->wlen == 0) watch_output(t, c, 0);
+}
+
+static LoadConn *next_active(LoadThread *t) {
+    for (int i = 0; i < t->nconns; i++) {
+        t->cursor = (t->cursor + 1) % t->nconns;
+        if (t->conns[t->cursor].state == CONN_ACTIVE) return &t->conns[t->cursor];
+    }
+    return NULL;
+}
+
+static void send_moves(LoadThread *t, PhaseStats *ps, double dt_sec, uint64_t now) {
+    static const char dirs[] = { DIR_UP, DIR_DOWN, DIR_LEFT, DIR_RIGHT };
+    double due = t->active * (cfg.move_rate / cfg.connections) * dt_sec;
+    t->move_credit += due;
+    ps->moves_due += due;
+
+    // Open loop: never wait for responses, but don't let a stall turn into an unbounded burst
+    double cap = t->active + 1.0;
+    if (t->move_credit > cap) {
+        ps->moves_skipped += (uint64_t)(t->move_credit - cap);
+        t->move_credit = cap;
+    }
+
+    while (t->move_credit >= 1.0) {
+        t->move_credit -= 1.0;
+        LoadConn *c = next_active(t);
+        if (!c) break;
+
+        MovePayload move;
+        move.direction = dirs[rand_r(&t->seed) % 4];
+        move.seq = c->next_seq + 1;
+        int rc = conn_send(t, c, ps, OP_MOVE, &move, sizeof(move), now);
+        if (rc == 0) {
+            c->next_seq = move.seq;
+            c->sent_at[move.seq % SEQ_WINDOW] = now;
+            ps->moves_sent++;
+        } else if (rc == -1) {
+            ps->moves_skipped++;
+        } else {
+            ps->errors++;
+            conn_close(t, c, now, RETRY_DELAY_US);
+        }
+    }
+}
+
+static void churn_one(LoadThread *t, PhaseStats *ps, uint64_t now) {
+    if (t->active == 0) return;
+    int start = rand_r(&t->seed) % t->nconns;
+    LoadConn *c = NULL;
+    for (int i = 0; i < t->nconns && !c; i++) {
+        LoadConn *cand = &t->conns[(start + i) % t->nconns];
+        if (cand->state == CONN_ACTIVE) c = cand;
+    }
+    if (!c) return;
+
+    int mode = cfg.churn_mode == CHURN_MIXED ? rand_r(&t->seed) % 3 : cfg.churn_mode;
+    ps->churn[mode]++;
+    if (mode == CHURN_LOGOUT) {
+        conn_send(t, c, ps, OP_LOGOUT, NULL, 0, now);
+        conn_close(t, c, now, CHURN_RECONNECT_US);
+    } else if (mode == CHURN_DROP) {
+        conn_close(t, c, now, CHURN_RECONNECT_US);
+    } else {
+        set_state(t, c, CONN_SILENT, now);
+    }
+}
+
+// Heartbeats for quiet connections and reconnects, at SCAN_INTERVAL_US granularity
+static void scan_connections(LoadThread *t, PhaseStats *ps, int phase, uint64_t now) {
+    uint64_t heartbeat_us = HEARTBEAT_INTERVAL_SEC * 1000000ULL;
+    for (int i = 0; i < t->opened; i++) {
+        LoadConn *c = &t->conns[i];
+        if (c->state == CONN_IDLE && phase < LOAD_PHASE_DRAIN && now >= c->retry_at) {
+            start_connect(t, c, ps, now);
+        } else if ((c->state == CONN_ACTIVE || c->state == CONN_WATCHING) && now - c->last_send > heartbeat_us) {
+            if (conn_send(t, c, ps, OP_HEARTBEAT, NULL, 0, now) == 0) ps->heartbeats++;
+        }
+    }
+}
+
+static void *load_thread_func(void *arg) {
+    LoadThread *t = (LoadThread *)arg;
+    struct epoll_event events[MAX_EVENTS];
+    uint64_t last = now_us();
+    double per_thread_churn = cfg.churn_rate / cfg.threads;
+
+    while (1) {
+        int phase = current_phase();
+        if (phase == LOAD_PHASE_DONE) break;
+        PhaseStats *ps = &t->phases[phase];
+        uint64_t now = now_us();
+        double dt = (now - last) / 1000000.0;
+        last = now;
+
+        // Ramp: open this thread's share of connections linearly over ramp_sec
+        if (phase < LOAD_PHASE_DRAIN) {
+            int target = t->nconns;
+            if (phase == LOAD_PHASE_RAMP && cfg.ramp_sec > 0) {
+                target = (int)(t->nconns * ((now - load_start_us) / (cfg.ramp_sec * 1000000.0)));
+                if (target > t->nconns) target = t->nconns;
+            }
+            while (t->opened < target) {
+                start_connect(t, &t->conns[t->opened++], ps, now);
+            }
+
+            send_moves(t, ps, dt, now);
+
+            t->churn_credit += per_thread_churn * dt;
+            while (t->churn_credit >= 1.0) {
+                t->churn_credit -= 1.0;
+                churn_one(t, ps, now);
+            }
+        }
+
+        if (now >= t->next_scan) {
+            scan_connections(t, ps, phase, now);
+            t->next_scan = now + SCAN_INTERVAL_US;
+        }
+
+        int n = epoll_wait(t->epfd, events, MAX_EVENTS, 1);
+        now = now_us();
+        for (int i = 0; i < n; i++) {
+            LoadConn *c = (LoadConn *)events[i].data.ptr;
+            if (c->fd < 0) continue; // Closed earlier in this batch
+            if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+                handle_writable(t, c, ps, now);
+            }
+            if (c->fd >= 0 && (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+                handle_readable(t, c, ps, now);
+            }
+        }
+    }
+
+    // Log out everything still connected
+    uint64_t now = now_us();
+    PhaseStats *ps = &t->phases[LOAD_PHASE_DRAIN];
+    for (int i = 0; i < t->opened; i++) {
+        LoadConn *c = &t->conns[i];
+        if (c->fd < 0) continue;
+        if (c->state == CONN_ACTIVE) conn_send(t, c, ps, OP_LOGOUT, NULL, 0, now);
+        conn_close(t, c, now, 0);
+    }
+    return NULL;
+}
+
+static void merge_phase(PhaseStats *dst, const PhaseStats *src) {
+    dst->moves_due += src->moves_due;
+    dst->moves_sent += src->moves_sent;
+    dst->moves_skipped += src->moves_skipped;
+    dst->connects += src->connects;
+    dst->connect_failures += src->connect_failures;
+    dst->logins += src->logins;
+    dst->login_rejects += src->login_rejects;
+    dst->heartbeats += src->heartbeats;
+    dst->updates += src->updates;
+    dst->spectates += src->spectates;
+    dst->spectator_updates += src->spectator_updates;
+    dst->scores += src->scores;
+    dst->bytes_in += src->bytes_in;
+    dst->bytes_out += src->bytes_out;
+    dst->deaths += src->deaths;
+    dst->server_closes += src->server_closes;
+    for (int i = 0; i < 3; i++) dst->churn[i] += src->churn[i];
+    dst->errors += src->errors;
+    hdr_merge(&dst->connect_us, &src->connect_us);
+    hdr_merge(&dst->login_us, &src->login_us);
+    hdr_merge(&dst->ack_us, &src->ack_us);
+}
+
+static void init_phase(PhaseStats *ps) {
+    memset(ps, 0, sizeof(*ps));
+    hdr_init(&ps->connect_us);
+    hdr_init(&ps->login_us);
+    hdr_init(&ps->ack_us);
+}
+
+static void print_report(PhaseStats *totals, double *phase_secs) {
+    const char **names = phase_names;
+
+    printf("\n==============================================================================\n");
+    printf("  Load Test Results (%d connections, %d threads, target %.0f moves/s)\n",
+           cfg.connections, cfg.threads, cfg.move_rate);
+    printf("==============================================================================\n");
+    printf("%-7s %6s %8s %8s %8s %9s %9s %8s %9s %8s %7s %6s\n",
+           "phase", "secs", "connects", "logins", "rejects", "due/s", "moves/s",
+           "skipped", "updates/s", "MB/s in", "churn", "errors");
+
+    for (int p = 0; p < LOAD_PHASES; p++) {
+        PhaseStats *ps = &totals[p];
+        double secs = phase_secs[p] > 0 ? phase_secs[p] : 1e-9;
+        printf("%-7s %6.1f %8llu %8llu %8llu %9.0f %9.0f %8llu %9.0f %8.2f %7llu %6llu\n",
+               names[p], phase_secs[p],
+               (unsigned long long)ps->connects, (unsigned long long)ps->logins,
+               (unsigned long long)ps->login_rejects, ps->moves_due / secs, ps->moves_sent / secs,
+               (unsigned long long)ps->moves_skipped, ps->updates / secs,
+               ps->bytes_in / secs / (1024.0 * 1024.0),
+               (unsigned long long)(ps->churn[0] + ps->churn[1] + ps->churn[2]),
+               (unsigned long long)ps->errors);
+    }
+
+    for (int p = 0; p < LOAD_PHASES; p++) {
+        PhaseStats *ps = &totals[p];
+        printf("------------------------------------------------------------------------------\n");
+        printf("%s: connect failures=%llu deaths=%llu server closes=%llu heartbeats=%llu scores=%llu "
+               "churn logout/drop/silent=%llu/%llu/%llu\n",
+               names[p], (unsigned long long)ps->connect_failures, (unsigned long long)ps->deaths,
+               (unsigned long long)ps->server_closes, (unsigned long long)ps->heartbeats,
+               (unsigned long long)ps->scores,
+               (unsigned long long)ps->churn[CHURN_LOGOUT], (unsigned long long)ps->churn[CHURN_DROP],
+               (unsigned long long)ps->churn[CHURN_SILENT]);
+        if (cfg.spectators > 0) {
+            double secs = phase_secs[p] > 0 ? phase_secs[p] : 1e-9;
+            printf("%s: spectators joined=%llu spectator updates/s=%.0f\n", names[p],
+                   (unsigned long long)ps->spectates, ps->spectator_updates / secs);
+        }
+        hdr_print_summary(&ps->connect_us, "connect", "us", stdout);
+        hdr_print_summary(&ps->login_us, "login", "us", stdout);
+        hdr_print_summary(&ps->ack_us, "move_ack", "us", stdout);
+    }
+    printf("==============================================================================\n");
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s -load [options]\n"
+            "  -c <n>          connections (default 1000)\n"
+            "  -spectators <n> extra connections that only watch (default 0)\n"
+            "  -threads <n>    epoll threads (default 4)\n"
+            "  -rate <n>       target moves/sec across all connections (default 5 per connection)\n"
+            "  -ramp <sec>     connection ramp-up time (default 5)\n"
+            "  -duration <sec> steady phase length (default 30)\n"
+            "  -drain <sec>    time to collect in-flight acks after moves stop (default 2)\n"
+            "  -churn <n>      churn events/sec across all connections (default 0)\n"
+            "  -churn-mode <logout|drop|silent|mixed>  (default mixed)\n"
+            "  -host <ip>      server address (default 127.0.0.1)\n"
+            "  -crc            frame with CRC32C instead of the 16-bit sum\n",
+            prog);
+}
+
+static void sleep_phase(int seconds) {
+    struct timespec ts;
+    ts.tv_sec = seconds;
+    ts.tv_nsec = 0;
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR);
+}
+
+int run_load_generator(int argc, char *argv[]) {
+    cfg.host = "127.0.0.1";
+    cfg.connections = 1000;
+    cfg.threads = 4;
+    cfg.move_rate = -1;
+    cfg.ramp_sec = 5;
+    cfg.duration_sec = 30;
+    cfg.drain_sec = 2;
+    cfg.churn_rate = 0;
+    cfg.churn_mode = CHURN_MIXED;
+
+    for (int i = 2; i < argc; i++) {
+        const char *opt = argv[i];
+        if (strcmp(opt, "-crc") == 0) {
+            proto_set_integrity(PROTO_CRC32C);
+            continue;
+        }
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!val) {
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+        if (strcmp(opt, "-c") == 0) cfg.connections = atoi(val);
+        else if (strcmp(opt, "-spectators") == 0) cfg.spectators = atoi(val);
+        else if (strcmp(opt, "-threads") == 0) cfg.threads = atoi(val);
+        else if (strcmp(opt, "-rate") == 0) cfg.move_rate = atof(val);
+        else if (strcmp(opt, "-ramp") == 0) cfg.ramp_sec = atoi(val);
+        else if (strcmp(opt, "-duration") == 0) cfg.duration_sec = atoi(val);
+        else if (strcmp(opt, "-drain") == 0) cfg.drain_sec = atoi(val);
+        else if (strcmp(opt, "-churn") == 0) cfg.churn_rate = atof(val);
+        else if (strcmp(opt, "-host") == 0) cfg.host = val;
+        else if (strcmp(opt, "-churn-mode") == 0) {
+            if (strcmp(val, "logout") == 0) cfg.churn_mode = CHURN_LOGOUT;
+            else if (strcmp(val, "drop") == 0) cfg.churn_mode = CHURN_DROP;
+            else if (strcmp(val, "silent") == 0) cfg.churn_mode = CHURN_SILENT;
+            else cfg.churn_mode = CHURN_MIXED;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (cfg.connections < 1) cfg.connections = 1;
+    if (cfg.spectators < 0) cfg.spectators = 0;
+    int total = cfg.connections + cfg.spectators;
+    if (cfg.threads < 1) cfg.threads = 1;
+    if (cfg.threads > total) cfg.threads = total;
+    if (cfg.move_rate < 0) cfg.move_rate = cfg.connections * 5.0;
+    if (cfg.ramp_sec < 0) cfg.ramp_sec = 0;
+
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(PORT);
+    if (inet_pton(AF_INET, cfg.host, &server_addr.sin_addr) != 1) {
+        fprintf(stderr, "Invalid host %s\n", cfg.host);
+        return 1;
+    }
+
+    // One fd per connection plus a few per thread
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        rlim_t want = (rlim_t)total + cfg.threads * 2 + 64;
+        if (rl.rlim_cur < want) {
+            rl.rlim_cur = want < rl.rlim_max ? want : rl.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &rl);
+            if (rl.rlim_cur < want) {
+                fprintf(stderr, "Warning: fd limit %llu is below the %d requested connections\n",
+                        (unsigned long long)rl.rlim_cur, total);
+            }
+        }
+    }
+
+    LoadConn *conns = calloc(total, sizeof(LoadConn));
+    LoadThread *threads = calloc(cfg.threads, sizeof(LoadThread));
+    if (!conns || !threads) {
+        perror("calloc");
+        return 1;
+    }
+    for (int i = 0; i < total; i++) {
+        conns[i].fd = -1;
+        conns[i].state = CONN_IDLE;
+        // Spread spectators evenly over the threads
+        conns[i].spectator = (long)i * cfg.spectators / total != (long)(i + 1) * cfg.spectators / total;
+    }
+
+    printf("========================================\n");
+    printf("  Load Test - %d connections, %d spectators, %d threads\n",
+           cfg.connections, cfg.spectators, cfg.threads);
+    printf("  Target %.0f moves/s, ramp %ds, steady %ds, churn %.1f/s\n",
+           cfg.move_rate, cfg.ramp_sec, cfg.duration_sec, cfg.churn_rate);
+    printf("========================================\n");
+    fflush(stdout);
+
+    load_start_us = now_us();
+    __atomic_store_n(&load_phase, LOAD_PHASE_RAMP, __ATOMIC_RELEASE);
+
+    for (int i = 0; i < cfg.threads; i++) {
+        LoadThread *t = &threads[i];
+        int first = (int)((long)total * i / cfg.threads);
+        int last = (int)((long)total * (i + 1) / cfg.threads);
+        t->conns = conns + first;
+        t->nconns = last - first;
+        t->seed = (unsigned int)time(NULL) ^ (unsigned int)(i * 2654435761u);
+        for (int p = 0; p < LOAD_PHASES; p++) init_phase(&t->phases[p]);
+        t->epfd = epoll_create1(0);
+        if (t->epfd < 0) {
+            perror("epoll_create1");
+            return 1;
+        }
+        pthread_create(&t->thread, NULL, load_thread_func, t);
+    }
+
+    // The main thread only switches phases
+    double phase_secs[LOAD_PHASES];
+    int durations[LOAD_PHASES] = { cfg.ramp_sec, cfg.duration_sec, cfg.drain_sec };
+    uint64_t phase_start = load_start_us;
+    for (int p = 0; p < LOAD_PHASES; p++) {
+        sleep_phase(durations[p]);
+        uint64_t now = now_us();
+        phase_secs[p] = (now - phase_start) / 1000000.0;
+        phase_start = now;
+        __atomic_store_n(&load_phase, p + 1, __ATOMIC_RELEASE);
+        if (p + 1 < LOAD_PHASES) {
+            printf("Phase %s done after %.1fs\n", phase_names[p], phase_secs[p]);
+            fflush(stdout);
+        }
+    }
+
+    PhaseStats *totals = malloc(sizeof(PhaseStats) * LOAD_PHASES);
+    if (!totals) {
+        perror("malloc");
+        return 1;
+    }
+    for (int p = 0; p < LOAD_PHASES; p++) init_phase(&totals[p]);
+    for (int i = 0; i < cfg.threads; i++) {
+        pthread_join(threads[i].thread, NULL);
+        close(threads[i].epfd);
+        for (int p = 0; p < LOAD_PHASES; p++) merge_phase(&totals[p], &threads[i].phases[p]);
+    }
+
+    print_report(totals, phase_secs);
+
+    free(totals);
+    free(threads);
+    free(conns);
+    return 0;
+}
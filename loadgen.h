@@ -0,0 +1,12 @@
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+// Event-driven load generator (client -load).
+// A few epoll threads drive thousands of non-blocking connections with an
+// open-loop move rate, a connection ramp-up and configurable churn, and
+// report throughput and latency per phase (ramp, steady, drain).
+
+// Parses the options following "-load" and runs the test. Returns process exit code.
+int run_load_generator(int argc, char *argv[]);
+
+#endif
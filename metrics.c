@@ -0,0 +1,167 @@
+#include "metrics.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+
+static const char *lock_site_names[LOCK_SITE_MAX] = {
+    "tick",
+    "login",
+    "move",
+    "cleanup",
+    "snapshot",
+    "version",
+    "checkpoint"
+};
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t pos;
+} OutBuf;
+
+// Past the end of buf only counts, so pos ends up as the length needed
+static void out_printf(OutBuf *out, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = out->pos < out->len ? vsnprintf(out->buf + out->pos, out->len - out->pos, fmt, args)
+                                : vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    if (n < 0) return;
+    out->pos += (size_t)n;
+}
+
+const char *lock_site_name(int site) {
+    if (site < 0 || site >= LOCK_SITE_MAX) return "unknown";
+    return lock_site_names[site];
+}
+
+uint64_t hist_percentile(const LatencyHist *h, double percentile) {
+    if (h->count == 0) return 0;
+    uint64_t target = (uint64_t)(h->count * percentile / 100.0);
+    if (target == 0) target = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= target) {
+            uint64_t upper = 1ULL << i;
+            return upper < h->max_ns ? upper : h->max_ns;
+        }
+    }
+    return h->max_ns;
+}
+
+static void format_hist(OutBuf *out, const char *name, const char *labels, const LatencyHist *h) {
+    // Snapshot the fields once; the writer may be updating them concurrently
+    LatencyHist snap = *h;
+    const char *sep = labels[0] ? "," : "";
+    uint64_t cumulative = 0;
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        if (snap.buckets[i] == 0) continue;
+        cumulative += snap.buckets[i];
+        if (i == HIST_BUCKETS - 1) break;
+        out_printf(out, "%s_bucket{%s%sle=\"%llu\"} %llu\n", name, labels, sep,
+                   1ULL << i, (unsigned long long)cumulative);
+    }
+    out_printf(out, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep,
+               (unsigned long long)snap.count);
+    // Prometheus omits the braces entirely for unlabeled series
+    const char *open = labels[0] ? "{" : "";
+    const char *close = labels[0] ? "}" : "";
+    out_printf(out, "%s_sum%s%s%s %llu\n", name, open, labels, close, (unsigned long long)snap.sum_ns);
+    out_printf(out, "%s_count%s%s%s %llu\n", name, open, labels, close, (unsigned long long)snap.count);
+    out_printf(out, "%s_max%s%s%s %llu\n", name, open, labels, close, (unsigned long long)snap.max_ns);
+    out_printf(out, "%s_p50%s%s%s %llu\n", name, open, labels, close,
+               (unsigned long long)hist_percentile(&snap, 50));
+    out_printf(out, "%s_p99%s%s%s %llu\n", name, open, labels, close,
+               (unsigned long long)hist_percentile(&snap, 99));
+}
+
+size_t metrics_format(const ServerMetrics *m, char *buf, size_t len) {
+    OutBuf out = { buf, len, 0 };
+    if (len == 0) return 0;
+    buf[0] = '\0';
+
+    out_printf(&out, "snake_uptime_seconds %lld\n", (long long)(time(NULL) - (time_t)m->start_time));
+    out_printf(&out, "snake_workers %u\n", m->num_workers);
+    out_printf(&out, "snake_child_restarts_total %llu\n", (unsigned long long)m->child_restarts);
+    out_printf(&out, "snake_upgrades_total %llu\n", (unsigned long long)m->upgrades);
+    out_printf(&out, "snake_lock_recoveries_total %llu\n", (unsigned long long)m->lock_recoveries);
+
+    const TickMetrics *t = &m->tick;
+    out_printf(&out, "snake_ticks_total %llu\n", (unsigned long long)t->ticks);
+    out_printf(&out, "snake_tick_overruns_total %llu\n", (unsigned long long)t->overruns);
+    out_printf(&out, "snake_players_alive %llu\n", (unsigned long long)t->players_alive);
+    format_hist(&out, "snake_tick_time_ns", "", &t->tick_time);
+    format_hist(&out, "snake_tick_lateness_ns", "", &t->lateness);
+    out_printf(&out, "snake_checkpoints_total %llu\n", (unsigned long long)t->checkpoints);
+    format_hist(&out, "snake_checkpoint_time_ns", "", &t->checkpoint_time);
+    out_printf(&out, "snake_broadcasts_total %llu\n", (unsigned long long)t->broadcasts);
+    format_hist(&out, "snake_broadcast_time_ns", "", &t->broadcast_time);
+
+    for (uint32_t i = 0; i < m->num_workers && i < MAX_WORKERS; i++) {
+        const WorkerMetrics *w = &m->workers[i];
+        char labels[32];
+        snprintf(labels, sizeof(labels), "worker=\"%u\"", i);
+
+        out_printf(&out, "snake_worker_connections{%s} %llu\n", labels, (unsigned long long)w->connections);
+        out_printf(&out, "snake_worker_players{%s} %llu\n", labels, (unsigned long long)w->players);
+        out_printf(&out, "snake_worker_packets_in_total{%s} %llu\n", labels, (unsigned long long)w->packets_in);
+        out_printf(&out, "snake_worker_packets_out_total{%s} %llu\n", labels, (unsigned long long)w->packets_out);
+        out_printf(&out, "snake_worker_bytes_in_total{%s} %llu\n", labels, (unsigned long long)w->bytes_in);
+        out_printf(&out, "snake_worker_bytes_out_total{%s} %llu\n", labels, (unsigned long long)w->bytes_out);
+        out_printf(&out, "snake_worker_accepts_total{%s} %llu\n", labels, (unsigned long long)w->accepts);
+        out_printf(&out, "snake_worker_logins_total{%s} %llu\n", labels, (unsigned long long)w->logins);
+        out_printf(&out, "snake_worker_disconnects_total{%s} %llu\n", labels, (unsigned long long)w->disconnects);
+        out_printf(&out, "snake_worker_timeouts_total{%s} %llu\n", labels, (unsigned long long)w->timeouts);
+        out_printf(&out, "snake_worker_send_errors_total{%s} %llu\n", labels, (unsigned long long)w->send_errors);
+        out_printf(&out, "snake_worker_udp_datagrams_in_total{%s} %llu\n", labels, (unsigned long long)w->udp_datagrams_in);
+        out_printf(&out, "snake_worker_udp_datagrams_out_total{%s} %llu\n", labels, (unsigned long long)w->udp_datagrams_out);
+        out_printf(&out, "snake_worker_udp_batches_total{%s} %llu\n", labels, (unsigned long long)w->udp_batches);
+        out_printf(&out, "snake_worker_udp_drops_total{%s} %llu\n", labels, (unsigned long long)w->udp_drops);
+        out_printf(&out, "snake_worker_io_syscalls_total{%s} %llu\n", labels, (unsigned long long)w->io_syscalls);
+        out_printf(&out, "snake_worker_spectators{%s} %llu\n", labels, (unsigned long long)w->spectators);
+        out_printf(&out, "snake_worker_spectator_frames_total{%s} %llu\n", labels, (unsigned long long)w->spectator_frames);
+        out_printf(&out, "snake_worker_spectator_skips_total{%s} %llu\n", labels, (unsigned long long)w->spectator_skips);
+        out_printf(&out, "snake_worker_broadcast_retries_total{%s} %llu\n", labels, (unsigned long long)w->broadcast_retries);
+        out_printf(&out, "snake_worker_scores_pushed_total{%s} %llu\n", labels, (unsigned long long)w->scores_pushed);
+        out_printf(&out, "snake_worker_throttled_total{%s} %llu\n", labels, (unsigned long long)w->throttled);
+        out_printf(&out, "snake_worker_abusers_total{%s} %llu\n", labels, (unsigned long long)w->abusers);
+        out_printf(&out, "snake_worker_moves_coalesced_total{%s} %llu\n", labels, (unsigned long long)w->moves_coalesced);
+        format_hist(&out, "snake_worker_lock_wait_ns", labels, &w->lock_wait);
+    }
+
+    for (int i = 0; i < LOCK_SITE_MAX; i++) {
+        char labels[32];
+        snprintf(labels, sizeof(labels), "site=\"%s\"", lock_site_names[i]);
+        format_hist(&out, "snake_lock_wait_ns", labels, &m->lock_sites[i].wait);
+        format_hist(&out, "snake_lock_hold_ns", labels, &m->lock_sites[i].hold);
+    }
+
+    if (out.pos >= len) buf[0] = '\0'; // Never hand out a cut-off body
+    return out.pos;
+}
+
+void metrics_print_lock_report(const ServerMetrics *m, FILE *out) {
+    fprintf(out, "%-9s %10s | %9s %9s %11s | %9s %9s %11s | %8s\n",
+            "site", "count", "wait p50", "wait p99", "wait max",
+            "hold p50", "hold p99", "hold max", "hold %");
+
+    // Share of wall time each site held the lock since startup
+    double uptime_ns = (double)(time(NULL) - (time_t)m->start_time) * 1e9;
+
+    for (int i = 0; i < LOCK_SITE_MAX; i++) {
+        LatencyHist wait = m->lock_sites[i].wait;
+        LatencyHist hold = m->lock_sites[i].hold;
+        fprintf(out, "%-9s %10llu | %9llu %9llu %11llu | %9llu %9llu %11llu | %7.3f%%\n",
+                lock_site_names[i], (unsigned long long)wait.count,
+                (unsigned long long)hist_percentile(&wait, 50),
+                (unsigned long long)hist_percentile(&wait, 99),
+                (unsigned long long)wait.max_ns,
+                (unsigned long long)hist_percentile(&hold, 50),
+                (unsigned long long)hist_percentile(&hold, 99),
+                (unsigned long long)hold.max_ns,
+                uptime_ns > 0 ? hold.sum_ns * 100.0 / uptime_ns : 0.0);
+    }
+    fprintf(out, "(times in ns, percentiles are log2 bucket upper bounds)\n");
+}
@@ -0,0 +1,117 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Server metrics, stored in the shared GameState segment.
+// Every block has exactly one writer (a worker or the game loop) and starts
+// on its own cache line, so counters are bumped without locks or atomics and
+// readers (OP_STATS) only ever see slightly stale values. The lock site
+// stats are the exception: they are written by whoever holds game_state->lock.
+
+#define CACHE_LINE_SIZE 64
+#define MAX_WORKERS 64
+#define HIST_BUCKETS 32 // log2 buckets over nanoseconds, last bucket is open ended
+
+// Call sites of game_state->lock
+#define LOCK_SITE_TICK     0
+#define LOCK_SITE_LOGIN    1
+#define LOCK_SITE_MOVE     2
+#define LOCK_SITE_CLEANUP  3 // Logout, disconnect and timeout
+#define LOCK_SITE_SNAPSHOT 4 // Map copy for OP_UPDATE
+#define LOCK_SITE_VERSION  5 // Version poll in the worker loop
+#define LOCK_SITE_CHECKPOINT 6 // World copy for a checkpoint
+#define LOCK_SITE_MAX      7
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    uint64_t buckets[HIST_BUCKETS]; // bucket i counts values < 2^i ns
+} LatencyHist;
+
+typedef struct {
+    uint64_t packets_in;
+    uint64_t packets_out;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t accepts;
+    uint64_t logins;
+    uint64_t disconnects;
+    uint64_t timeouts;
+    uint64_t send_errors;
+    uint64_t connections; // Currently open
+    uint64_t players;     // Currently logged in
+    uint64_t udp_datagrams_in;
+    uint64_t udp_datagrams_out;
+    uint64_t udp_batches;   // sendmmsg() calls
+    uint64_t udp_drops;     // Datagrams rejected (bad session or stale seq) or not sent
+    uint64_t io_syscalls;   // Socket syscalls (select backend) or io_uring_enter() calls
+    uint64_t spectators;        // Currently watching (OP_SPECTATE)
+    uint64_t spectator_frames;  // Broadcast frames sent to spectators
+    uint64_t spectator_skips;   // Ticks spectators missed: slow socket or busy worker
+    uint64_t broadcast_retries; // Broadcast ring reads that raced the game loop
+    uint64_t scores_pushed;     // OP_SCORES sent
+    uint64_t throttled;         // Inbound packets dropped by the rate limit
+    uint64_t abusers;           // Connections dropped for flooding
+    uint64_t moves_coalesced;   // Moves superseded by a newer one before being applied
+    LatencyHist lock_wait;
+} __attribute__((aligned(CACHE_LINE_SIZE))) WorkerMetrics;
+
+typedef struct {
+    uint64_t ticks;
+    uint64_t overruns;     // Ticks that started a full period late
+    uint64_t players_alive;
+    LatencyHist tick_time; // Time spent holding the lock per tick
+    LatencyHist lateness;  // Tick start vs. its scheduled deadline
+    uint64_t checkpoints;
+    LatencyHist checkpoint_time; // Writing a snapshot to the checkpoint file (lock not held)
+    uint64_t broadcasts;
+    LatencyHist broadcast_time;  // Encoding the spectator frame into the broadcast ring (lock not held)
+} __attribute__((aligned(CACHE_LINE_SIZE))) TickMetrics;
+
+typedef struct {
+    LatencyHist wait;
+    LatencyHist hold;
+} LockSiteMetrics;
+
+typedef struct {
+    uint64_t start_time; // Unix time the server started
+    uint32_t num_workers;
+    uint64_t child_restarts; // Workers and game loops re-forked by the master
+    uint64_t upgrades;       // Hot upgrades this world has been handed through
+    WorkerMetrics workers[MAX_WORKERS];
+    TickMetrics tick;
+
+    // Protected by game_state->lock
+    LockSiteMetrics lock_sites[LOCK_SITE_MAX] __attribute__((aligned(CACHE_LINE_SIZE)));
+    uint64_t lock_recoveries; // EOWNERDEAD recoveries
+    int lock_holder_site;
+    uint64_t lock_acquired_ns;
+} ServerMetrics;
+
+static inline void hist_record(LatencyHist *h, uint64_t ns) {
+    int bucket = ns == 0 ? 0 : 64 - __builtin_clzll(ns);
+    if (bucket >= HIST_BUCKETS) bucket = HIST_BUCKETS - 1;
+    h->buckets[bucket]++;
+    h->count++;
+    h->sum_ns += ns;
+    if (ns > h->max_ns) h->max_ns = ns;
+}
+
+// Upper bound (ns) of the bucket containing the given percentile (0-100)
+uint64_t hist_percentile(const LatencyHist *h, double percentile);
+
+// Formats all metrics in Prometheus text exposition format.
+// Returns the length of the text (excluding the terminator). Like snprintf,
+// a result >= len means buf was too small; buf is then left empty.
+size_t metrics_format(const ServerMetrics *m, char *buf, size_t len);
+
+const char *lock_site_name(int site);
+
+// Human-readable per-site lock wait/hold table
+void metrics_print_lock_report(const ServerMetrics *m, FILE *out);
+
+#endif
@@ -0,0 +1,129 @@
+#include "predict.h"
+
+#include <string.h>
+
+static int opposite(char a, char b) {
+    return (a == DIR_UP && b == DIR_DOWN) || (a == DIR_DOWN && b == DIR_UP) ||
+           (a == DIR_LEFT && b == DIR_RIGHT) || (a == DIR_RIGHT && b == DIR_LEFT);
+}
+
+// The snake comes off the network: its length is clamped to PredSnake and
+// every cell must be on the map. Returns the usable length, -1 if invalid.
+static int view_length(const SnakeView *v) {
+    int length = v->length > MAX_SNAKE_LENGTH ? MAX_SNAKE_LENGTH : v->length;
+    for (int j = 0; j < length; j++) {
+        if (v->body[j][0] >= MAP_WIDTH || v->body[j][1] >= MAP_HEIGHT) return -1;
+    }
+    return length;
+}
+
+void predict_init(Predictor *p) {
+    memset(p, 0, sizeof(*p));
+    p->next_seq = 1;
+}
+
+// Same rules as game_tick() for one snake: walls and other snakes kill,
+// food grows. A predicted death leaves the snake where it is.
+static void predict_step(Predictor *p) {
+    const UpdateFrame *f = &p->auth;
+    PredSnake *s = &p->predicted;
+
+    s->length = f->self.length;
+    s->direction = f->self.direction;
+    for (int j = 0; j < s->length; j++) {
+        s->body[j].x = f->self.body[j][0];
+        s->body[j].y = f->self.body[j][1];
+    }
+    p->have_prediction = s->length > 0;
+    if (!p->have_prediction) return;
+
+    // The server applies moves as they arrive, rejecting 180 degree turns
+    for (int i = 0; i < p->num_pending; i++) {
+        if (!opposite(s->direction, p->pending[i].dir)) s->direction = p->pending[i].dir;
+    }
+
+    Point head = s->body[0];
+    if (s->direction == DIR_UP) head.y--;
+    else if (s->direction == DIR_DOWN) head.y++;
+    else if (s->direction == DIR_LEFT) head.x--;
+    else if (s->direction == DIR_RIGHT) head.x++;
+    if (head.x < 0 || head.x >= MAP_WIDTH || head.y < 0 || head.y >= MAP_HEIGHT) return;
+
+    int cell = f->map[head.y][head.x];
+    if (cell == CELL_WALL || cell >= CELL_PLAYER_BASE) return;
+
+    if (cell == CELL_FOOD && s->length < MAX_SNAKE_LENGTH) s->length++;
+    for (int j = s->length - 1; j > 0; j--) {
+        s->body[j] = s->body[j - 1];
+    }
+    s->body[0] = head;
+}
+
+uint32_t predict_input(Predictor *p, char dir) {
+    uint32_t seq = p->next_seq++;
+    if (p->num_pending == PREDICT_MAX_PENDING) {
+        // Server is far behind; forget the oldest
+        memmove(p->pending, p->pending + 1, (PREDICT_MAX_PENDING - 1) * sizeof(PendingMove));
+        p->num_pending--;
+    }
+    p->pending[p->num_pending].seq = seq;
+    p->pending[p->num_pending].dir = dir;
+    p->num_pending++;
+    if (p->have_auth) predict_step(p);
+    return seq;
+}
+
+void predict_update(Predictor *p, const UpdateFrame *frame) {
+    int length = view_length(&frame->self);
+    if (length < 0) return; // Keep showing the last good frame
+    p->frames++;
+
+    // Was this the tick we predicted?
+    if (p->have_auth && p->have_prediction && frame->header.tick == p->auth.header.tick + 1) {
+        p->compared++;
+        const SnakeView *v = &frame->self;
+        int match = length == p->predicted.length;
+        for (int j = 0; match && j < length; j++) {
+            match = v->body[j][0] == p->predicted.body[j].x && v->body[j][1] == p->predicted.body[j].y;
+        }
+        if (!match) p->corrections++;
+    }
+
+    memcpy(&p->auth, frame, sizeof(*frame));
+    p->auth.self.length = (uint16_t)length;
+    p->have_auth = 1;
+
+    // Drop moves the server has applied
+    int keep = 0;
+    for (int i = 0; i < p->num_pending; i++) {
+        if (p->pending[i].seq > frame->header.ack_seq) p->pending[keep++] = p->pending[i];
+    }
+    p->num_pending = keep;
+
+    predict_step(p);
+}
+
+void predict_glyphs(const Predictor *p, int player_id, char glyphs[MAP_HEIGHT][MAP_WIDTH]) {
+    const UpdateFrame *f = &p->auth;
+    for (int y = 0; y < MAP_HEIGHT; y++) {
+        for (int x = 0; x < MAP_WIDTH; x++) {
+            int cell = f->map[y][x];
+            if (cell == CELL_WALL) glyphs[y][x] = '#';
+            else if (cell == CELL_FOOD) glyphs[y][x] = '@';
+            else if (cell == CELL_EMPTY) glyphs[y][x] = ' ';
+            else if (cell == CELL_PLAYER_BASE + player_id) glyphs[y][x] = ' '; // Drawn below
+            else glyphs[y][x] = 'X'; // Others
+        }
+    }
+
+    if (!p->have_prediction) {
+        // Nothing to predict from; show the server's view
+        for (int j = 0; j < f->self.length; j++) {
+            glyphs[f->self.body[j][1]][f->self.body[j][0]] = 'O';
+        }
+        return;
+    }
+    for (int j = 0; j < p->predicted.length; j++) {
+        glyphs[p->predicted.body[j].y][p->predicted.body[j].x] = 'O';
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef PREDICT_H
+#define PREDICT_H
+
+#include <stdint.h>
+
+#include "common.h"
+
+// Client-side prediction for the interactive client.
+// The displayed own snake runs one tick ahead of the last authoritative
+// frame: it is the frame's snake (UpdateFrame.self) stepped once with the
+// direction that results from replaying every move the server has not yet
+// acknowledged (seq > ack_seq). A key press therefore shows up immediately
+// instead of after the next tick plus a round trip. When the frame for the
+// predicted tick arrives, the prediction is checked against it; a mismatch
+// (e.g. the move reached the server a tick late) is a correction, and the
+// client snaps to the server's snake.
+
+#define PREDICT_MAX_PENDING 64
+
+typedef struct {
+    int length;
+    char direction;
+    Point body[MAX_SNAKE_LENGTH];
+} PredSnake;
+
+typedef struct {
+    uint32_t seq;
+    char dir;
+} PendingMove;
+
+typedef struct {
+    UpdateFrame auth;          // Last authoritative frame
+    int have_auth;
+    PendingMove pending[PREDICT_MAX_PENDING];
+    int num_pending;
+    uint32_t next_seq;
+    PredSnake predicted;       // Own snake at tick auth.header.tick + 1
+    int have_prediction;
+    unsigned long frames;
+    unsigned long compared;    // Frames that arrived for a tick we had predicted
+    unsigned long corrections; // ...and did not match the prediction
+} Predictor;
+
+void predict_init(Predictor *p);
+
+// Records a local move and re-predicts. Returns the seq to send with it.
+uint32_t predict_input(Predictor *p, char dir);
+
+// Reconciles with a new authoritative frame and predicts the next tick.
+// A frame whose own snake lies off the map is ignored.
+void predict_update(Predictor *p, const UpdateFrame *frame);
+
+// Map glyphs with the own snake (player_id) drawn at its predicted position
+void predict_glyphs(const Predictor *p, int player_id, char glyphs[MAP_HEIGHT][MAP_WIDTH]);
+
+#endif
@@ -4,15 +4,48 @@
 #include "common.h"
 #include <stddef.h>
 
+// Frame integrity check, chosen per frame (OP_FLAG_CRC32C). Receivers
+// accept both; a server answers each connection the way it last heard from it.
+#define PROTO_SUM    0 // 16-bit sum of the plain payload in PacketHeader.checksum
+#define PROTO_CRC32C 1 // ExtendedHeader: CRC32C of the encrypted payload
+
 // Function Prototypes
 uint16_t calculate_checksum(const unsigned char *data, size_t len);
 void xor_cipher(unsigned char *data, size_t len);
 
+// sizeof(PacketHeader) or sizeof(ExtendedHeader)
+size_t proto_header_size(int integrity);
+
+// Header plus payload length of the frame starting at buf, which holds at
+// least sizeof(PacketHeader) bytes
+size_t proto_frame_size(const unsigned char *buf);
+
+// Integrity used by send_packet and encode_packet, PROTO_SUM until set.
+// Call before starting threads.
+void proto_set_integrity(int integrity);
+
 // Returns 0 on success, -1 on failure
 int send_packet(int sockfd, uint16_t opcode, const void *payload, uint32_t payload_len);
 
+// Buffer-based framing for non-blocking I/O.
+// Writes header + encrypted payload into out. Returns the frame length, or -1 if out is too small.
+int encode_packet(unsigned char *out, size_t out_len, uint16_t opcode, const void *payload, uint32_t payload_len);
+
+// Parses one frame from the start of buf, decrypting its payload in place.
+// Returns bytes consumed, 0 if the frame is incomplete, -1 if it is malformed.
+// *payload points into buf (NULL for an empty payload).
+int decode_packet(unsigned char *buf, size_t len, uint16_t *opcode, unsigned char **payload, uint32_t *payload_len);
+
 // Returns 0 on success, -1 on failure/disconnect. 
 // Allocates memory for *payload which must be freed by caller.
 int recv_packet(int sockfd, uint16_t *opcode, void **payload, uint32_t *payload_len);
 
+// The same with the integrity check given, or reported (may be NULL)
+int send_frame(int sockfd, uint16_t opcode, const void *payload, uint32_t payload_len, int integrity);
+int encode_frame(unsigned char *out, size_t out_len, uint16_t opcode, const void *payload, uint32_t payload_len,
+                 int integrity);
+int decode_frame(unsigned char *buf, size_t len, uint16_t *opcode, unsigned char **payload, uint32_t *payload_len,
+                 int *integrity);
+int recv_frame(int sockfd, uint16_t *opcode, void **payload, uint32_t *payload_len, int *integrity);
+
 #endif
@@ -0,0 +1,45 @@
+#include "ratelimit.h"
+
+#define NS_PER_SEC 1000000000ULL
+
+void ratelimit_config(RateLimitConfig *cfg, uint32_t packets_per_sec, uint32_t bytes_per_sec) {
+    cfg->packets_per_sec = packets_per_sec;
+    cfg->packet_burst = packets_per_sec * 2;
+    cfg->bytes_per_sec = bytes_per_sec;
+    cfg->byte_burst = bytes_per_sec * 2;
+    cfg->max_throttled = packets_per_sec * 2; // Sending at three times the rate or more
+}
+
+static void refill(double *tokens, uint32_t rate, uint32_t burst, uint64_t elapsed_ns) {
+    *tokens += (double)rate * elapsed_ns / NS_PER_SEC;
+    if (*tokens > burst) *tokens = burst;
+}
+
+int ratelimit_check(RateLimit *rl, const RateLimitConfig *cfg, uint32_t bytes, uint64_t now_ns) {
+    if (cfg->packets_per_sec == 0) return RATE_OK;
+
+    if (rl->last_ns == 0) {
+        rl->packets = cfg->packet_burst;
+        rl->bytes = cfg->byte_burst;
+        rl->last_ns = now_ns;
+        rl->window_ns = now_ns;
+    } else if (now_ns > rl->last_ns) {
+        refill(&rl->packets, cfg->packets_per_sec, cfg->packet_burst, now_ns - rl->last_ns);
+        refill(&rl->bytes, cfg->bytes_per_sec, cfg->byte_burst, now_ns - rl->last_ns);
+        rl->last_ns = now_ns;
+    }
+
+    if (rl->packets >= 1 && rl->bytes >= bytes) {
+        rl->packets -= 1;
+        rl->bytes -= bytes;
+        return RATE_OK;
+    }
+
+    if (now_ns - rl->window_ns >= NS_PER_SEC) {
+        rl->window_ns = now_ns;
+        rl->throttled = 0;
+    }
+    rl->throttled++;
+    if (cfg->max_throttled > 0 && rl->throttled > cfg->max_throttled) return RATE_ABUSE;
+    return RATE_THROTTLED;
+}
@@ -0,0 +1,40 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include <stdint.h>
+
+// Per-connection input limits for the workers. Every inbound packet costs
+// one token from a packet bucket and its size from a byte bucket; both
+// refill continuously up to their burst. A packet finding either bucket
+// short is over the limit: the caller drops it if it is droppable input.
+// A connection that keeps sending over the limit is an abuser and gets
+// disconnected.
+
+#define RATE_OK        0
+#define RATE_THROTTLED 1 // Over the limit, nothing charged
+#define RATE_ABUSE     2 // Drop the connection
+
+typedef struct {
+    uint32_t packets_per_sec;  // 0 = no limits
+    uint32_t packet_burst;
+    uint32_t bytes_per_sec;
+    uint32_t byte_burst;
+    uint32_t max_throttled;    // Dropped packets within one second that make an abuser, 0 = never
+} RateLimitConfig;
+
+typedef struct {
+    double packets;      // Tokens left
+    double bytes;
+    uint64_t last_ns;    // Last refill, 0 = fresh connection
+    uint64_t window_ns;  // Start of the current one second window
+    uint32_t throttled;  // Dropped in the current window
+} RateLimit;
+
+// Fills the config from the packet rate: burst of two seconds, and the
+// byte limits sized for small control packets
+void ratelimit_config(RateLimitConfig *cfg, uint32_t packets_per_sec, uint32_t bytes_per_sec);
+
+// Charges one packet of `bytes` bytes. A zeroed RateLimit starts with full buckets.
+int ratelimit_check(RateLimit *rl, const RateLimitConfig *cfg, uint32_t bytes, uint64_t now_ns);
+
+#endif
@@ -0,0 +1,69 @@
+#include "record.h"
+#include "game.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static int record_fd = -1;
+
+int record_open(const char *path, uint64_t seed) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd == -1) {
+        perror("record open");
+        return -1;
+    }
+
+    RecordHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = RECORD_MAGIC;
+    hdr.version = RECORD_VERSION;
+    hdr.entry_size = sizeof(RecordEntry);
+    hdr.seed = seed;
+    hdr.map_width = MAP_WIDTH;
+    hdr.map_height = MAP_HEIGHT;
+    hdr.max_players = MAX_PLAYERS;
+    hdr.max_snake_length = MAX_SNAKE_LENGTH;
+    if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+        perror("record header");
+        close(fd);
+        return -1;
+    }
+
+    record_fd = fd;
+    return 0;
+}
+
+void record_close(void) {
+    if (record_fd != -1) close(record_fd);
+    record_fd = -1;
+}
+
+static void record_write(const RecordEntry *e) {
+    // One small O_APPEND write per entry: never interleaves with other processes
+    if (write(record_fd, e, sizeof(*e)) != sizeof(*e)) {
+        perror("record write");
+        record_close(); // A log with a gap cannot be replayed
+    }
+}
+
+void record_input(uint8_t type, int player, char dir, uint32_t seq) {
+    if (record_fd == -1) return;
+    RecordEntry e;
+    memset(&e, 0, sizeof(e));
+    e.type = type;
+    e.player = (uint8_t)player;
+    e.dir = dir;
+    e.seq = seq;
+    record_write(&e);
+}
+
+void record_tick(const GameState *gs) {
+    if (record_fd == -1) return;
+    RecordEntry e;
+    memset(&e, 0, sizeof(e));
+    e.type = REC_TICK;
+    e.value = game_hash(gs);
+    record_write(&e);
+}
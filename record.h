@@ -0,0 +1,53 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdint.h>
+
+#include "common.h"
+
+// Input recording for deterministic replay.
+// The log holds the world seed followed by every input applied to the
+// simulation (logins, moves, removals) and one entry per tick carrying the
+// hash of the world after it. Entries are appended while holding the game
+// lock, so the file order is the order the world saw them in.
+// ./replay re-runs a log headlessly and checks every tick hash.
+
+#define RECORD_MAGIC   0x474F4C59414C5052ULL // "RPLAYLOG"
+#define RECORD_VERSION 1
+
+// Entry types
+#define REC_LOGIN  1 // player = id game_add_player returned
+#define REC_MOVE   2 // player, dir, seq
+#define REC_REMOVE 3 // player (logout, disconnect, timeout, reclaim, death cleanup)
+#define REC_TICK   4 // value = game_hash after the tick
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t seed;
+    uint32_t map_width;
+    uint32_t map_height;
+    uint32_t max_players;
+    uint32_t max_snake_length;
+} RecordHeader;
+
+typedef struct {
+    uint8_t type;
+    uint8_t player;
+    char dir;
+    uint8_t reserved;
+    uint32_t seq;
+    uint64_t value;
+} RecordEntry;
+
+// Creates the log and writes its header. The descriptor is inherited across
+// fork and opened O_APPEND, so every process can record. Returns 0 or -1.
+int record_open(const char *path, uint64_t seed);
+void record_close(void);
+
+// No-ops unless record_open succeeded. Call with the game lock held.
+void record_input(uint8_t type, int player, char dir, uint32_t seq);
+void record_tick(const GameState *gs); // Hashes the world only when recording
+
+#endif
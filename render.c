@@ -0,0 +1,116 @@
+#include "render.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+
+// Full frame: map rows with newlines plus escapes and the status line
+#define RENDER_MAP_BYTES (MAP_HEIGHT * (MAP_WIDTH + 16))
+#define RENDER_BUF_SIZE (RENDER_MAP_BYTES + RENDER_STATUS_MAX + 64)
+#define RENDER_CELL_MAX 16 // Cursor move plus glyph
+
+// Full frames fit by construction; a diff that would not is drawn as a full frame
+static void buf_append(Screen *s, const char *data, size_t n) {
+    if (s->len + n > s->cap) return;
+    memcpy(s->buf + s->len, data, n);
+    s->len += n;
+}
+
+static void buf_printf(Screen *s, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(s->buf + s->len, s->cap - s->len, fmt, ap);
+    va_end(ap);
+    if (n > 0 && s->len + n < s->cap) s->len += n;
+}
+
+static void buf_flush(Screen *s) {
+    size_t off = 0;
+    while (off < s->len) {
+        ssize_t n = write(STDOUT_FILENO, s->buf + off, s->len - off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        off += n;
+    }
+    s->bytes_written += off;
+    s->len = 0;
+}
+
+int render_init(Screen *s) {
+    memset(s, 0, sizeof(*s));
+    s->cap = RENDER_BUF_SIZE;
+    s->buf = malloc(s->cap);
+    if (!s->buf) return -1;
+    fflush(stdout); // Anything printf'd so far goes out before our writes
+    buf_append(s, "\033[?25l", 6);
+    buf_flush(s);
+    return 0;
+}
+
+void render_invalidate(Screen *s) {
+    s->valid = 0;
+}
+
+// Emits cursor moves and glyphs for the changed cells. Returns -1, with
+// nothing on screen or in cells touched, if that is more than a full frame.
+static int render_diff(Screen *s, char glyphs[MAP_HEIGHT][MAP_WIDTH]) {
+    // Terminal rows/columns are 1-based. A cursor move is only needed
+    // when the changed cell does not directly follow the last one written.
+    int cur_y = -1, cur_x = -1;
+    for (int y = 0; y < MAP_HEIGHT; y++) {
+        if (memcmp(s->cells[y], glyphs[y], MAP_WIDTH) == 0) continue;
+        for (int x = 0; x < MAP_WIDTH; x++) {
+            if (s->cells[y][x] == glyphs[y][x]) continue;
+            if (s->len + RENDER_CELL_MAX > RENDER_MAP_BYTES) {
+                s->len = 0;
+                return -1;
+            }
+            if (y != cur_y || x != cur_x) buf_printf(s, "\033[%d;%dH", y + 1, x + 1);
+            buf_append(s, &glyphs[y][x], 1);
+            cur_y = y;
+            cur_x = x + 1;
+        }
+    }
+    memcpy(s->cells, glyphs, sizeof(s->cells));
+    return 0;
+}
+
+void render_frame(Screen *s, char glyphs[MAP_HEIGHT][MAP_WIDTH], const char *status) {
+    s->len = 0;
+
+    if (s->valid && render_diff(s, glyphs) < 0) s->valid = 0;
+    if (!s->valid) {
+        buf_append(s, "\033[H\033[2J", 7);
+        for (int y = 0; y < MAP_HEIGHT; y++) {
+            buf_append(s, glyphs[y], MAP_WIDTH);
+            buf_append(s, "\r\n", 2);
+        }
+        memcpy(s->cells, glyphs, sizeof(s->cells));
+        s->status[0] = '\0';
+        s->valid = 1;
+    }
+
+    if (strcmp(s->status, status) != 0) {
+        buf_printf(s, "\033[%d;1H%s\033[K", MAP_HEIGHT + 1, status);
+        snprintf(s->status, sizeof(s->status), "%s", status);
+    }
+
+    if (s->len > 0) {
+        buf_printf(s, "\033[%d;1H", MAP_HEIGHT + 2); // Park below, where printf messages go
+        buf_flush(s);
+    }
+    s->frames++;
+}
+
+void render_close(Screen *s) {
+    s->len = 0;
+    buf_printf(s, "\033[%d;1H\033[?25h", MAP_HEIGHT + 2);
+    buf_flush(s);
+    free(s->buf);
+    s->buf = NULL;
+}
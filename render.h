@@ -0,0 +1,32 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stddef.h>
+
+#include "common.h"
+
+// Diff-based terminal renderer for the interactive client.
+// Keeps the frame that is on screen and, for each new frame, emits cursor
+// moves and glyphs only for cells that changed, assembled into one buffer
+// and written with a single write(). The first frame, and the first after
+// render_invalidate() (e.g. terminal resize), is drawn in full.
+
+#define RENDER_STATUS_MAX 160
+
+typedef struct {
+    char cells[MAP_HEIGHT][MAP_WIDTH]; // Glyphs currently on screen
+    char status[RENDER_STATUS_MAX];    // Status line below the map
+    int valid;                         // 0: screen content unknown, redraw everything
+    char *buf;
+    size_t cap;
+    size_t len;
+    size_t bytes_written;              // Totals, for comparing against full redraws
+    unsigned long frames;
+} Screen;
+
+int render_init(Screen *s);   // Hides the cursor. Returns 0, or -1 if out of memory.
+void render_invalidate(Screen *s);
+void render_frame(Screen *s, char glyphs[MAP_HEIGHT][MAP_WIDTH], const char *status);
+void render_close(Screen *s); // Shows the cursor below the map and frees the buffer
+
+#endif
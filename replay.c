@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "game.h"
+#include "record.h"
+
+// Headless replay of an input log written by ./server -record.
+// Rebuilds the world from the recorded seed, feeds it the recorded inputs
+// and runs the ticks back to back, checking each tick hash against the log.
+
+static RecordEntry *entries = NULL;
+static size_t num_entries = 0;
+static RecordHeader header;
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int load_log(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != RECORD_MAGIC ||
+        header.version != RECORD_VERSION || header.entry_size != sizeof(RecordEntry)) {
+        fprintf(stderr, "%s: not a replay log\n", path);
+        fclose(f);
+        return -1;
+    }
+    if (header.map_width != MAP_WIDTH || header.map_height != MAP_HEIGHT ||
+        header.max_players != MAX_PLAYERS || header.max_snake_length != MAX_SNAKE_LENGTH) {
+        fprintf(stderr, "%s: recorded with different game constants (%ux%u, %u players)\n",
+                path, header.map_width, header.map_height, header.max_players);
+        fclose(f);
+        return -1;
+    }
+
+    size_t cap = 4096;
+    entries = malloc(cap * sizeof(RecordEntry));
+    RecordEntry e;
+    while (entries && fread(&e, sizeof(e), 1, f) == 1) {
+        if (num_entries == cap) {
+            cap *= 2;
+            entries = realloc(entries, cap * sizeof(RecordEntry));
+            if (!entries) break;
+        }
+        entries[num_entries++] = e;
+    }
+    fclose(f);
+    if (!entries) {
+        perror("malloc");
+        return -1;
+    }
+    return 0;
+}
+
+// Returns the number of ticks run, or -1 at the first divergence
+static long replay(GameState *gs, int check, int verbose) {
+    long ticks = 0;
+    TickResult result;
+
+    memset(gs, 0, sizeof(GameState));
+    for (int i = 0; i < MAX_PLAYERS; i++) gs->player_owner[i] = -1;
+    game_init(gs, header.seed);
+
+    for (size_t i = 0; i < num_entries; i++) {
+        RecordEntry *e = &entries[i];
+        if (e->type != REC_TICK && e->player >= MAX_PLAYERS) {
+            fprintf(stderr, "entry %zu: bad player id %u\n", i, e->player);
+            return -1;
+        }
+
+        switch (e->type) {
+        case REC_LOGIN: {
+            int id = game_add_player(gs, 0);
+            if (id != e->player) {
+                fprintf(stderr, "entry %zu (tick %ld): login got player %d, log has %u\n",
+                        i, ticks, id, e->player);
+                return -1;
+            }
+            break;
+        }
+        case REC_MOVE:
+            game_move(gs, e->player, e->dir, e->seq);
+            break;
+        case REC_REMOVE:
+            game_remove_player(gs, e->player);
+            break;
+        case REC_TICK:
+            game_tick(gs, &result);
+            ticks++;
+            if (check) {
+                uint64_t h = game_hash(gs);
+                if (h != e->value) {
+                    fprintf(stderr, "tick %ld (entry %zu): hash %016llx, log has %016llx\n",
+                            ticks, i, (unsigned long long)h, (unsigned long long)e->value);
+                    return -1;
+                }
+            }
+            if (verbose && result.num_deaths > 0) {
+                for (int d = 0; d < result.num_deaths; d++) {
+                    printf("tick %ld: player %d died\n", ticks, result.deaths[d]);
+                }
+            }
+            break;
+        default:
+            fprintf(stderr, "entry %zu: unknown type %u\n", i, e->type);
+            return -1;
+        }
+    }
+    return ticks;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = NULL;
+    int check = 1;
+    int verbose = 0;
+    int loops = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-nocheck") == 0) {
+            check = 0;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = 1;
+        } else if (strcmp(argv[i], "-loops") == 0 && i + 1 < argc) {
+            loops = atoi(argv[++i]);
+        } else if (path == NULL && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL || loops < 1) {
+        fprintf(stderr, "Usage: %s [-nocheck] [-loops n] [-v] <file.rec>\n", argv[0]);
+        return 1;
+    }
+
+    if (load_log(path) < 0) return 1;
+
+    size_t counts[5] = { 0 };
+    for (size_t i = 0; i < num_entries; i++) {
+        if (entries[i].type <= REC_TICK) counts[entries[i].type]++;
+    }
+    printf("Log: seed %llu, %zu entries (%zu logins, %zu moves, %zu removes, %zu ticks)\n",
+           (unsigned long long)header.seed, num_entries,
+           counts[REC_LOGIN], counts[REC_MOVE], counts[REC_REMOVE], counts[REC_TICK]);
+
+    GameState *gs = malloc(sizeof(GameState));
+    if (!gs) {
+        perror("malloc");
+        return 1;
+    }
+
+    long ticks = 0;
+    double start = now_sec();
+    for (int l = 0; l < loops; l++) {
+        long n = replay(gs, check, verbose && l == 0);
+        if (n < 0) {
+            printf("Replay DIVERGED from the recording\n");
+            free(gs);
+            free(entries);
+            return 2;
+        }
+        ticks += n;
+    }
+    double elapsed = now_sec() - start;
+
+    printf("Replayed %ld ticks in %.3f s: %.0f ticks/sec%s\n", ticks, elapsed,
+           elapsed > 0 ? ticks / elapsed : 0.0, check ? " (hashes checked)" : "");
+    if (check) printf("All tick hashes match\n");
+
+    free(gs);
+    free(entries);
+    return 0;
+}
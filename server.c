@@ -1,3 +1,4 @@
+#define _GNU_SOURCE // sendmmsg
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,29 +14,122 @@
 #include <sys/wait.h>
 #include <pthread.h>
 #include <sys/select.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
 #include <time.h>
+#include <sched.h>
 
 #include "common.h"
 #include "proto.h"
+#include "trace.h"
+#include "game.h"
+#include "record.h"
+#include "checkpoint.h"
+#include "handoff.h"
+#include "uring.h"
+#include "broadcast.h"
+#include "leaderboard.h"
+#include "ratelimit.h"
+#include "crc32c.h"
 
 #define NUM_WORKERS 8
 #define TICK_RATE_MS 200
+#define STATS_BASE_SIZE (16 * 1024)  // OP_STATS text besides the per-worker part
+#define STATS_WORKER_SIZE (3 * 1024) // Per worker, with room for the lock histogram
+#define UDP_BATCH 32          // Update datagrams per sendmmsg() call
+#define UDP_SNDBUF (1024 * 1024)
+#define SPECTATOR_ID -2       // client_ids value of a connection watching with OP_SPECTATE
+#define MAX_CONN_FDS 16384    // Size of fd-indexed per-connection state (select stops at FD_SETSIZE)
+#define RATE_LIMIT_PACKETS 50 // Default inbound packets/s per connection (-rate-limit)
+#define RATE_LIMIT_BYTES 4096 // Default inbound bytes/s per connection
+#define INPUT_CHUNK 2048      // Smallest input buffer, and the most one recv adds past a frame
+#define INPUT_MAX (sizeof(ExtendedHeader) + MAX_PAYLOAD_SIZE + INPUT_CHUNK)
+
+#define IO_BACKEND_SELECT 0
+#define IO_BACKEND_URING  1
 
 int shmid;
 GameState *game_state;
-int server_fd;
 pid_t workers[NUM_WORKERS];
 pid_t game_loop_pid;
 int running = 1;
+volatile sig_atomic_t dump_locks = 0;
+int checkpointing = 0;
+CheckpointWorld *checkpoint_buf = NULL; // Off-lock staging copy for checkpoint_write
+volatile sig_atomic_t upgrade_requested = 0;
+int worker_ctl[NUM_WORKERS];  // Master's end of each worker's control socket
+char **saved_argv;            // To exec the new binary on upgrade
+int io_backend = IO_BACKEND_SELECT; // Worker socket I/O (-io)
+int num_threads = 0;          // -threads: worker threads in one process, 0 = prefork processes
+int worker_cpus[MAX_WORKERS]; // -threads: CPU each worker thread is pinned to
+int tick_cpu = -1;            // -tick-cpu: CPU the game loop is pinned to, -1 = none
+int verbose = 0;              // -v: log every connection and player event (-trace records them regardless)
+RateLimitConfig rate_limit;   // -rate-limit: per-connection inbound limits
+
+// Per-worker state. Thread-local so that -threads can run several workers
+// in one process; in prefork mode each worker process has one copy anyway.
+__thread int server_fd = -1;
+__thread int current_worker = -1; // Worker slot, -1 in master and game loop
+__thread WorkerMetrics *worker_metrics = NULL; // This worker's block in the shared segment
+__thread int ctl_fd = -1;         // Worker's end of the control socket, -1 in -threads mode
+__thread int uring_worker = 0;    // This worker runs the io_uring backend
+
+// Client connections received from the previous master, given to workers at fork
+typedef struct {
+    HandoffMsg msg;
+    int fd;
+} InheritedClient;
+
+InheritedClient inherited[FD_SETSIZE];
+int num_inherited = 0;
+
+// Datagram channel of a player served by this worker (OP_UDP_REQ, then OP_UDP_HELLO)
+typedef struct {
+    int fd;            // TCP connection that requested it, -1 if none
+    uint32_t token;    // Session token at request time; a new login invalidates it
+    int bound;         // addr is known (OP_UDP_HELLO received)
+    uint32_t seq_in;   // Last datagram seq received
+    uint32_t seq_out;  // Last datagram seq sent
+    struct sockaddr_in addr;
+} UdpPeer;
+
+__thread int udp_fd = -1;       // In a worker: its datagram socket on an ephemeral port
+__thread uint16_t udp_port = 0; // Network byte order
+__thread UdpPeer udp_peers[MAX_PLAYERS];
+
+uint64_t game_lock(int site);
+void game_unlock();
+int uring_queue_reply(int fd, uint16_t opcode, const void *payload, uint32_t len);
+void uring_progress(int fd);
+void worker_loop_uring(int worker_id);
+int open_listener(int incoming_cpu);
+
+// Children are gone by now; a final checkpoint makes the next -restore lose nothing
+void write_final_checkpoint() {
+    game_lock(LOCK_SITE_CHECKPOINT);
+    checkpoint_capture(game_state, checkpoint_buf);
+    game_unlock();
+    uint64_t seq = checkpoint_write(checkpoint_buf);
+    checkpoint_close();
+    printf("Wrote checkpoint #%llu (version %llu).\n",
+           (unsigned long long)seq, (unsigned long long)checkpoint_buf->version);
+}
 
 void cleanup_resources() {
     printf("Cleaning up resources...\n");
+    if (game_state && checkpointing) {
+        write_final_checkpoint();
+    }
     if (game_state) {
+        printf("Lock contention report:\n");
+        metrics_print_lock_report(&game_state->metrics, stdout);
         // Destroy mutex
         pthread_mutex_destroy(&game_state->lock);
         // Detach shared memory
         shmdt(game_state);
     }
+    record_close();
     // Remove shared memory
     if (shmid != -1) {
         shmctl(shmid, IPC_RMID, NULL);
@@ -43,6 +137,7 @@ void cleanup_resources() {
     if (server_fd != -1) {
         close(server_fd);
     }
+    trace_close();
 }
 
 void handle_sigint(int sig) {
@@ -59,220 +154,817 @@ void handle_sigint(int sig) {
     exit(0);
 }
 
-void init_game_map() {
+void handle_sigusr1(int sig) {
+    dump_locks = 1;
+}
+
+void handle_sigusr2(int sig) {
+    upgrade_requested = 1;
+}
+
+// Game loop: finish the current tick and exit (upgrade handoff)
+void handle_stop(int sig) {
+    running = 0;
+}
+
+void init_game_map(uint64_t seed) {
     memset(game_state, 0, sizeof(GameState));
     
-    // Initialize Mutex with PTHREAD_PROCESS_SHARED
+    // Initialize Mutex with PTHREAD_PROCESS_SHARED.
+    // Robust so that a process dying while holding it hands the next locker
+    // EOWNERDEAD instead of deadlocking every other process.
     pthread_mutexattr_t attr;
     pthread_mutexattr_init(&attr);
     pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
     pthread_mutex_init(&game_state->lock, &attr);
     pthread_mutexattr_destroy(&attr);
 
-    // Initialize Map
+    game_init(game_state, seed);
+}
+
+// Called with the lock held after its previous owner died mid-update.
+// Snakes are the source of truth: drop any that are corrupt, then redraw
+// every player cell on the map from the surviving snake bodies.
+void recover_world() {
     for (int y = 0; y < MAP_HEIGHT; y++) {
         for (int x = 0; x < MAP_WIDTH; x++) {
-            if (x == 0 || x == MAP_WIDTH - 1 || y == 0 || y == MAP_HEIGHT - 1) {
-                game_state->map[y][x] = CELL_WALL;
-            } else {
+            if (game_state->map[y][x] >= CELL_PLAYER_BASE) {
                 game_state->map[y][x] = CELL_EMPTY;
             }
         }
     }
 
-    // Place some initial food
-    srand(time(NULL));
-    for (int i = 0; i < 20; i++) {
-        int rx = rand() % (MAP_WIDTH - 2) + 1;
-        int ry = rand() % (MAP_HEIGHT - 2) + 1;
-        game_state->map[ry][rx] = CELL_FOOD;
+    int dropped = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (!game_state->active_players[i]) continue;
+        Snake *s = &game_state->snakes[i];
+        int valid = s->alive && s->length >= 1 && s->length <= MAX_SNAKE_LENGTH;
+        for (int j = 0; valid && j < s->length; j++) {
+            Point p = s->body[j];
+            if (p.x <= 0 || p.x >= MAP_WIDTH - 1 || p.y <= 0 || p.y >= MAP_HEIGHT - 1) valid = 0;
+        }
+        if (!valid) {
+            // The tick will never advance it; its worker sees it inactive and sends OP_DIE
+            s->alive = 0;
+            game_state->active_players[i] = 0;
+            dropped++;
+            continue;
+        }
+        for (int j = 0; j < s->length; j++) {
+            game_state->map[s->body[j].y][s->body[j].x] = CELL_PLAYER_BASE + i;
+        }
+    }
+
+    leaderboard_rebuild(game_state); // May have been mid-update too
+    game_state->version++; // Force a fresh update to every client
+    game_state->metrics.lock_recoveries++;
+    printf("Recovered game state after lock owner died (%d players dropped).\n", dropped);
+}
+
+// Instrumented game_state->lock: wait and hold times are recorded per call
+// site. The site stats are only written while holding the lock, so they need
+// no synchronization of their own. Returns the time the lock was acquired.
+uint64_t game_lock(int site) {
+    uint64_t start = trace_now_ns();
+    int rc = pthread_mutex_lock(&game_state->lock);
+    if (rc == EOWNERDEAD) {
+        trace_event(TRACE_LOCK_RECOVERED, site, game_state->metrics.lock_holder_site);
+        recover_world();
+        pthread_mutex_consistent(&game_state->lock);
+    } else if (rc != 0) {
+        fprintf(stderr, "game lock unusable: %s\n", strerror(rc));
+        exit(1);
     }
+    uint64_t now = trace_now_ns();
+
+    ServerMetrics *m = &game_state->metrics;
+    hist_record(&m->lock_sites[site].wait, now - start);
+    m->lock_holder_site = site;
+    m->lock_acquired_ns = now;
+    if (worker_metrics) hist_record(&worker_metrics->lock_wait, now - start);
+    return now;
+}
+
+void game_unlock() {
+    ServerMetrics *m = &game_state->metrics;
+    hist_record(&m->lock_sites[m->lock_holder_site].hold, trace_now_ns() - m->lock_acquired_ns);
+    pthread_mutex_unlock(&game_state->lock);
 }
 
-void spawn_food() {
-    // Assumes lock is held
-    int placed = 0;
-    while (!placed) {
-        int rx = rand() % (MAP_WIDTH - 2) + 1;
-        int ry = rand() % (MAP_HEIGHT - 2) + 1;
-        if (game_state->map[ry][rx] == CELL_EMPTY) {
-            game_state->map[ry][rx] = CELL_FOOD;
-            placed = 1;
+void sleep_until_ns(uint64_t deadline_ns) {
+    struct timespec ts;
+    ts.tv_sec = deadline_ns / 1000000000ULL;
+    ts.tv_nsec = deadline_ns % 1000000000ULL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && running);
+}
+
+// Restored players whose clients never came back. Called with the lock held.
+void expire_detached_players() {
+    int dropped = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (game_state->active_players[i] && game_state->detached[i]) {
+            game_remove_player(game_state, i);
+            dropped++;
         }
     }
+    game_state->resume_deadline = 0;
+    if (dropped > 0) printf("Dropped %d restored players that did not resume.\n", dropped);
 }
 
 void game_tick_loop() {
     printf("Game Loop Process Started (PID: %d)\n", getpid());
+    trace_event(TRACE_PROC_START, TRACE_ROLE_GAME_LOOP, 0);
+
+    TickMetrics *tm = &game_state->metrics.tick;
+    uint64_t period_ns = (uint64_t)TICK_RATE_MS * 1000000ULL;
+    uint64_t next_tick = trace_now_ns();
+
     while (running) {
-        pthread_mutex_lock(&game_state->lock);
-        
-        for (int i = 0; i < MAX_PLAYERS; i++) {
-            if (game_state->active_players[i] && game_state->snakes[i].alive) {
-                Snake *s = &game_state->snakes[i];
-                Point head = s->body[0];
-                Point new_head = head;
-
-                if (s->direction == DIR_UP) new_head.y--;
-                else if (s->direction == DIR_DOWN) new_head.y++;
-                else if (s->direction == DIR_LEFT) new_head.x--;
-                else if (s->direction == DIR_RIGHT) new_head.x++;
-
-                // Check collisions
-                int collision = 0;
-                if (game_state->map[new_head.y][new_head.x] == CELL_WALL) collision = 1;
-                else if (game_state->map[new_head.y][new_head.x] >= CELL_PLAYER_BASE) {
-                     // Hit self or other
-                     collision = 1;
-                }
+        uint64_t start = trace_now_ns();
+        hist_record(&tm->lateness, start > next_tick ? start - next_tick : 0);
 
-                if (collision) {
-                    // Die
-                    s->alive = 0;
-                    game_state->active_players[i] = 0; // Mark inactive so workers know
-                    // Clear body
-                    for (int j = 0; j < s->length; j++) {
-                        game_state->map[s->body[j].y][s->body[j].x] = CELL_EMPTY;
-                    }
-                    printf("Player %d died.\n", i);
-                } else {
-                    int grow = 0;
-                    if (game_state->map[new_head.y][new_head.x] == CELL_FOOD) {
-                        grow = 1;
-                        game_state->scores[i]++;
-                        spawn_food();
-                    }
+        UpdateFrame spectator_frame; // Players get their own snake; spectators all get this one
+        memset(&spectator_frame, 0, sizeof(spectator_frame)); // Tail padding included: it is published as is
+        uint64_t locked = game_lock(LOCK_SITE_TICK);
+        trace_event(TRACE_TICK_BEGIN, game_state->version, 0);
+        if (game_state->resume_deadline != 0 && (uint64_t)time(NULL) >= game_state->resume_deadline) {
+            expire_detached_players();
+        }
+        TickResult result;
+        game_tick(game_state, &result);
+        record_tick(game_state);
+        for (int d = 0; d < result.num_deaths; d++) {
+            int i = result.deaths[d];
+            trace_event(TRACE_DEATH, i, game_state->scores[i]);
+        }
+        trace_event(TRACE_TICK_END, game_state->version, result.alive);
+        spectator_frame.header.tick = game_state->version;
+        memcpy(spectator_frame.map, game_state->map, sizeof(game_state->map));
+        game_unlock();
+        for (int d = 0; verbose && d < result.num_deaths; d++) printf("Player %d died.\n", result.deaths[d]);
 
-                    // Move Body
-                    // If not growing, clear tail
-                    if (!grow) {
-                        Point tail = s->body[s->length - 1];
-                        game_state->map[tail.y][tail.x] = CELL_EMPTY;
-                    } else {
-                        if (s->length < MAX_SNAKE_LENGTH) {
-                            s->length++;
-                        }
-                    }
+        uint64_t unlocked = trace_now_ns();
+        hist_record(&tm->tick_time, unlocked - locked);
+        tm->ticks++;
+        tm->players_alive = result.alive;
 
-                    // Shift body segments
-                    for (int j = s->length - 1; j > 0; j--) {
-                        s->body[j] = s->body[j - 1];
-                    }
-                    s->body[0] = new_head;
-                    game_state->map[new_head.y][new_head.x] = CELL_PLAYER_BASE + i;
-                }
-            }
+        // Encoded once here, then copied by every worker without the lock
+        broadcast_publish(&game_state->broadcast, &spectator_frame);
+        hist_record(&tm->broadcast_time, trace_now_ns() - unlocked);
+        tm->broadcasts++;
+
+        // Copy under the lock, write to the file without it
+        if (checkpointing && tm->ticks % CHECKPOINT_INTERVAL_TICKS == 0) {
+            game_lock(LOCK_SITE_CHECKPOINT);
+            checkpoint_capture(game_state, checkpoint_buf);
+            game_unlock();
+            uint64_t t = trace_now_ns();
+            checkpoint_write(checkpoint_buf);
+            hist_record(&tm->checkpoint_time, trace_now_ns() - t);
+            tm->checkpoints++;
+        }
+
+        // Fixed-rate schedule; if we already missed the next deadline, count it and resync
+        next_tick += period_ns;
+        uint64_t now = trace_now_ns();
+        if (now > next_tick) {
+            tm->overruns++;
+            next_tick = now;
+        } else {
+            sleep_until_ns(next_tick);
+        }
+    }
+}
+
+// Moves received on a connection since the worker last applied them
+typedef struct {
+    int queued;        // fd is in pending_fds
+    int player_id;     // -1 once the connection is closed
+    char dir;          // Newest direction
+    char prev;         // The different one before it, 0 if none
+    uint32_t seq;      // Newest non-zero seq
+} PendingMove;
+
+// Received bytes not yet forming a whole frame
+typedef struct {
+    unsigned char *data;
+    uint32_t len, cap;
+} InputBuf;
+
+// Per-connection input state, indexed by fd
+__thread InputBuf *conn_input;          // select backend
+__thread RateLimit *conn_limits;
+__thread unsigned char *conn_integrity; // PROTO_* of the last frame received
+__thread PendingMove *pending_moves;
+__thread int *pending_fds;
+__thread int num_pending = 0;
+
+void alloc_conn_state() {
+    conn_input = calloc(MAX_CONN_FDS, sizeof(InputBuf));
+    conn_limits = calloc(MAX_CONN_FDS, sizeof(RateLimit));
+    conn_integrity = calloc(MAX_CONN_FDS, 1);
+    pending_moves = calloc(MAX_CONN_FDS, sizeof(PendingMove));
+    pending_fds = malloc(MAX_CONN_FDS * sizeof(int));
+    if (!conn_input || !conn_limits || !conn_integrity || !pending_moves || !pending_fds) {
+        perror("malloc");
+        exit(1);
+    }
+}
+
+void reset_conn_state(int fd) {
+    free(conn_input[fd].data);
+    memset(&conn_input[fd], 0, sizeof(InputBuf));
+    memset(&conn_limits[fd], 0, sizeof(RateLimit));
+    conn_integrity[fd] = PROTO_SUM;
+    pending_moves[fd].player_id = -1;
+}
+
+// Makes room for n more bytes. Returns -1 if the buffer would pass INPUT_MAX.
+int input_reserve(InputBuf *b, uint32_t n) {
+    uint32_t need = b->len + n;
+    if (need <= b->cap) return 0;
+    if (need > INPUT_MAX) return -1;
+    if (need < INPUT_CHUNK) need = INPUT_CHUNK;
+    unsigned char *data = realloc(b->data, need);
+    if (!data) return -1;
+    b->data = data;
+    b->cap = need;
+    return 0;
+}
+
+// Drops the whole frames at the front. The buffer is then sized for the
+// partial frame left, once its header is in, so the rest of it arrives
+// without regrowing; one grown for a large frame shrinks back.
+// Returns -1 if it cannot hold that frame.
+int input_consume(InputBuf *b, uint32_t off) {
+    memmove(b->data, b->data + off, b->len - off);
+    b->len -= off;
+
+    uint32_t want = INPUT_CHUNK;
+    if (b->len >= sizeof(PacketHeader)) {
+        size_t frame = proto_frame_size(b->data); // decode_frame() checked the length
+        if (frame > want) want = frame;
+    }
+    if (want > b->cap) return input_reserve(b, want - b->len);
+    if (b->cap > 2 * want) {
+        unsigned char *data = realloc(b->data, want);
+        if (data) {
+            b->data = data;
+            b->cap = want;
+        }
+    }
+    return 0;
+}
+
+// Coalesces moves until the next flush_moves(), i.e. within one pass of the
+// worker loop, not one tick; every one still counts as received for the ack
+void queue_move(int fd, int player_id, const MovePayload *move) {
+    PendingMove *p = &pending_moves[fd];
+    if (p->queued && p->player_id == player_id) {
+        worker_metrics->moves_coalesced++;
+        if (move->direction != p->dir) {
+            p->prev = p->dir;
+            p->dir = move->direction;
+        }
+    } else {
+        if (!p->queued) pending_fds[num_pending++] = fd;
+        p->queued = 1;
+        p->player_id = player_id;
+        p->dir = move->direction;
+        p->prev = 0;
+        p->seq = 0;
+    }
+    if (move->seq != 0) p->seq = move->seq;
+}
+
+// Applies every queued move under one lock. For each connection the newest
+// direction wins, or the one before it when the newest would be a U-turn
+// from where the snake is heading now. Called after every pass: holding moves
+// until the tick would need the tick deadline, which workers do not see, and
+// a move that missed it would wait a whole tick. Moves of one tick that come
+// in separate passes each take the lock, but game_move() only sets the
+// heading, so the tick still steers by the last one accepted.
+void flush_moves() {
+    if (num_pending == 0) return;
+    game_lock(LOCK_SITE_MOVE);
+    for (int i = 0; i < num_pending; i++) {
+        PendingMove *p = &pending_moves[pending_fds[i]];
+        p->queued = 0;
+        if (p->player_id < 0) continue;
+
+        char dir = p->dir;
+        int turned = game_move(game_state, p->player_id, dir, p->seq);
+        record_input(REC_MOVE, p->player_id, dir, p->seq);
+        if (!turned && p->prev != 0) {
+            dir = p->prev;
+            turned = game_move(game_state, p->player_id, dir, p->seq);
+            record_input(REC_MOVE, p->player_id, dir, p->seq);
         }
-        
-        game_state->version++;
-        pthread_mutex_unlock(&game_state->lock);
-        usleep(TICK_RATE_MS * 1000);
+        if (turned) trace_event(TRACE_MOVE, p->player_id, (uint64_t)dir);
     }
+    game_unlock();
+    num_pending = 0;
 }
 
-void handle_client_message(int client_fd, int *player_id) {
-    uint16_t opcode;
-    void *payload = NULL;
-    uint32_t len;
+int worker_send(int fd, uint16_t opcode, const void *payload, uint32_t len) {
+    if (uring_worker) return uring_queue_reply(fd, opcode, payload, len);
+    worker_metrics->io_syscalls++;
+    if (send_frame(fd, opcode, payload, len, conn_integrity[fd]) < 0) {
+        worker_metrics->send_errors++;
+        return -1;
+    }
+    worker_metrics->packets_out++;
+    worker_metrics->bytes_out += proto_header_size(conn_integrity[fd]) + len;
+    return 0;
+}
+
+void worker_close_client(int fd, int player_id) {
+    close(fd);
+    reset_conn_state(fd);
+    worker_metrics->connections--;
+    if (player_id >= 0) worker_metrics->players--;
+    if (player_id == SPECTATOR_ID) worker_metrics->spectators--;
+}
+
+void send_stats(int client_fd) {
+    size_t cap = STATS_BASE_SIZE + (size_t)game_state->metrics.num_workers * STATS_WORKER_SIZE;
+    for (;;) {
+        char *buf = malloc(cap);
+        if (!buf) return;
+        size_t len = metrics_format(&game_state->metrics, buf, cap);
+        if (len < cap) {
+            worker_send(client_fd, OP_STATS_RESP, buf, len);
+            free(buf);
+            return;
+        }
+        free(buf);
+        if (len >= MAX_PAYLOAD_SIZE) {
+            fprintf(stderr, "Metrics need %zu bytes, more than one packet\n", len);
+            worker_send(client_fd, OP_STATS_RESP, NULL, 0);
+            return;
+        }
+        cap = len + 1;
+    }
+}
+
+// Handles one decoded packet. Returns -1 if the connection must be closed
+// (rejected login, logout or input flood; *player_id is what worker_close_client needs), 0 otherwise.
+int handle_packet(int client_fd, int *player_id, uint16_t opcode, void *payload, uint32_t len) {
+    int closed = 0;
+
+    size_t frame_len = proto_header_size(conn_integrity[client_fd]) + len;
+    worker_metrics->packets_in++;
+    worker_metrics->bytes_in += frame_len;
 
-    if (recv_packet(client_fd, &opcode, &payload, &len) < 0) {
-        // Disconnect
+    // Only moves are dropped when over the limit. Control packets (login,
+    // logout, heartbeat, stats) are always handled, so a client at the limit
+    // is never left waiting for an answer; they still count toward abuse.
+    int verdict = ratelimit_check(&conn_limits[client_fd], &rate_limit, frame_len, trace_now_ns());
+    if (verdict == RATE_THROTTLED && opcode == OP_MOVE) {
+        worker_metrics->throttled++;
+        return 0;
+    }
+    if (verdict == RATE_ABUSE) {
+        worker_metrics->abusers++;
+        if (verbose) printf("Dropping fd %d (player %d): input flood.\n", client_fd, *player_id);
+        trace_event(TRACE_FLOOD, *player_id, client_fd);
         if (*player_id >= 0) {
-            pthread_mutex_lock(&game_state->lock);
-            game_state->active_players[*player_id] = 0;
-            // Remove player from map
-            for(int y=0; y<MAP_HEIGHT; y++) {
-                for(int x=0; x<MAP_WIDTH; x++) {
-                    if(game_state->map[y][x] == CELL_PLAYER_BASE + *player_id) {
-                        game_state->map[y][x] = CELL_EMPTY;
-                    }
-                }
-            }
-            pthread_mutex_unlock(&game_state->lock);
-            printf("Player %d disconnected.\n", *player_id);
+            game_lock(LOCK_SITE_CLEANUP);
+            game_remove_player(game_state, *player_id);
+            record_input(REC_REMOVE, *player_id, 0, 0);
+            game_unlock();
         }
-        close(client_fd);
-        *player_id = -1; // Signal to remove from select set
-        return;
+        return -1;
     }
 
-    if (opcode == OP_LOGIN_REQ) {
-        pthread_mutex_lock(&game_state->lock);
+    if (opcode == OP_LOGIN_REQ && *player_id != SPECTATOR_ID) {
+        LoginResponse resp;
+        int resumed = 0;
+        game_lock(LOCK_SITE_LOGIN);
         int new_id = -1;
-        for (int i = 0; i < MAX_PLAYERS; i++) {
-            if (!game_state->active_players[i]) {
-                game_state->active_players[i] = 1;
-                game_state->scores[i] = 0;
-                new_id = i;
-                
-                // Initialize Snake
-                game_state->snakes[i].length = 1;
-                game_state->snakes[i].alive = 1;
-                game_state->snakes[i].direction = DIR_RIGHT; // Default
-
-                // Spawn player
-                int placed = 0;
-                while(!placed) {
-                    int rx = rand() % (MAP_WIDTH - 2) + 1;
-                    int ry = rand() % (MAP_HEIGHT - 2) + 1;
-                    if (game_state->map[ry][rx] == CELL_EMPTY) {
-                        game_state->map[ry][rx] = CELL_PLAYER_BASE + new_id;
-                        game_state->snakes[i].body[0].x = rx;
-                        game_state->snakes[i].body[0].y = ry;
-                        placed = 1;
-                    }
-                }
-                break;
-            }
+        if (len >= sizeof(LoginRequest)) {
+            LoginRequest req;
+            memcpy(&req, payload, sizeof(req));
+            new_id = game_resume_player(game_state, req.player_id, req.token, current_worker);
+            resumed = new_id != -1;
         }
-        pthread_mutex_unlock(&game_state->lock);
+        if (new_id == -1) {
+            // Unknown or expired resume requests just get a new snake
+            new_id = game_add_player(game_state, current_worker);
+            if (new_id != -1) record_input(REC_LOGIN, new_id, 0, 0);
+        }
+        if (new_id != -1) resp.token = game_state->player_token[new_id];
+        game_unlock();
 
         if (new_id != -1) {
             *player_id = new_id;
-            send_packet(client_fd, OP_LOGIN_RESP, &new_id, sizeof(int));
-            printf("Player %d logged in.\n", new_id);
+            resp.player_id = new_id;
+            worker_send(client_fd, OP_LOGIN_RESP, &resp, sizeof(resp));
+            worker_metrics->logins++;
+            worker_metrics->players++;
+            if (verbose) printf("Player %d %s.\n", new_id, resumed ? "resumed" : "logged in");
+            trace_event(TRACE_LOGIN, new_id, client_fd);
         } else {
             // Server full
-            send_packet(client_fd, OP_ERROR, "Server Full", 11);
-            close(client_fd);
-            *player_id = -1;
-        }
-    } else if (opcode == OP_MOVE && *player_id >= 0) {
-        char dir = *((char*)payload);
-        pthread_mutex_lock(&game_state->lock);
-        
-        if (game_state->active_players[*player_id] && game_state->snakes[*player_id].alive) {
-            // Prevent 180 turn
-            char current = game_state->snakes[*player_id].direction;
-            if (!((current == DIR_UP && dir == DIR_DOWN) ||
-                  (current == DIR_DOWN && dir == DIR_UP) ||
-                  (current == DIR_LEFT && dir == DIR_RIGHT) ||
-                  (current == DIR_RIGHT && dir == DIR_LEFT))) {
-                game_state->snakes[*player_id].direction = dir;
-            }
+            trace_event(TRACE_LOGIN_FULL, client_fd, 0);
+            worker_send(client_fd, OP_ERROR, "Server Full", 11);
+            closed = -1;
         }
-        pthread_mutex_unlock(&game_state->lock);
+    } else if (opcode == OP_SPECTATE && *player_id == -1) {
+        *player_id = SPECTATOR_ID;
+        worker_send(client_fd, OP_SPECTATE, NULL, 0);
+        worker_metrics->spectators++;
+    } else if (opcode == OP_MOVE && *player_id >= 0 && len >= 1) {
+        MovePayload move = { *((char*)payload), 0 };
+        if (len >= sizeof(MovePayload)) memcpy(&move, payload, sizeof(MovePayload));
+        queue_move(client_fd, *player_id, &move);
+    } else if (opcode == OP_UDP_REQ && *player_id >= 0) {
+        UdpResponse resp = { udp_fd >= 0 ? udp_port : 0, 0 };
+        UdpPeer *p = &udp_peers[*player_id];
+        memset(p, 0, sizeof(*p));
+        p->fd = udp_fd >= 0 ? client_fd : -1;
+        p->token = game_state->player_token[*player_id];
+        worker_send(client_fd, OP_UDP_RESP, &resp, sizeof(resp));
     } else if (opcode == OP_HEARTBEAT) {
         // Respond with heartbeat ACK
-        send_packet(client_fd, OP_HEARTBEAT_ACK, NULL, 0);
+        worker_send(client_fd, OP_HEARTBEAT_ACK, NULL, 0);
+    } else if (opcode == OP_STATS) {
+        send_stats(client_fd);
     } else if (opcode == OP_LOGOUT && *player_id >= 0) {
         // Client requested logout
-        pthread_mutex_lock(&game_state->lock);
-        game_state->active_players[*player_id] = 0;
-        for(int y=0; y<MAP_HEIGHT; y++) {
-            for(int x=0; x<MAP_WIDTH; x++) {
-                if(game_state->map[y][x] == CELL_PLAYER_BASE + *player_id) {
-                    game_state->map[y][x] = CELL_EMPTY;
-                }
+        game_lock(LOCK_SITE_CLEANUP);
+        game_remove_player(game_state, *player_id);
+        record_input(REC_REMOVE, *player_id, 0, 0);
+        game_unlock();
+        if (verbose) printf("Player %d logged out.\n", *player_id);
+        trace_event(TRACE_LOGOUT, *player_id, client_fd);
+        closed = -1;
+    }
+
+    return closed;
+}
+
+// select backend: the client is gone (EOF, error or corrupt frame)
+void drop_client(int client_fd, int *player_id) {
+    worker_metrics->disconnects++;
+    if (*player_id >= 0) {
+        game_lock(LOCK_SITE_CLEANUP);
+        game_remove_player(game_state, *player_id);
+        record_input(REC_REMOVE, *player_id, 0, 0);
+        game_unlock();
+        if (verbose) printf("Player %d disconnected.\n", *player_id);
+        trace_event(TRACE_DISCONNECT, *player_id, client_fd);
+    }
+    worker_close_client(client_fd, *player_id);
+    *player_id = -1;
+}
+
+// Handles every whole frame in the connection's input buffer.
+// Returns -1 if the connection was closed, 0 otherwise
+int handle_client_frames(int client_fd, int *player_id) {
+    InputBuf *b = &conn_input[client_fd];
+    uint32_t off = 0;
+    for (;;) {
+        uint16_t opcode;
+        unsigned char *payload;
+        uint32_t len;
+        int integrity;
+        int r = decode_frame(b->data + off, b->len - off, &opcode, &payload, &len, &integrity);
+        if (r == 0) break;
+        if (r < 0) {
+            drop_client(client_fd, player_id); // Malformed or corrupt
+            return -1;
+        }
+        off += r;
+
+        conn_integrity[client_fd] = integrity; // Answer the way the client last spoke
+        if (handle_packet(client_fd, player_id, opcode, payload, len) < 0) {
+            worker_close_client(client_fd, *player_id);
+            *player_id = -1;
+            return -1;
+        }
+    }
+    if (input_consume(b, off) < 0) {
+        drop_client(client_fd, player_id);
+        return -1;
+    }
+    return 0;
+}
+
+// select backend: one recv of whatever the connection has buffered, so a
+// burst of moves is handled (and coalesced) in one wakeup; a partial frame
+// waits for the next one.
+// Returns -1 if the connection was closed, 0 otherwise
+int handle_client_input(int client_fd, int *player_id) {
+    InputBuf *b = &conn_input[client_fd];
+    ssize_t n = -1;
+    if (input_reserve(b, b->cap > b->len ? 0 : INPUT_CHUNK) == 0) {
+        worker_metrics->io_syscalls++;
+        n = recv(client_fd, b->data + b->len, b->cap - b->len, 0);
+    }
+    if (n <= 0) {
+        drop_client(client_fd, player_id);
+        return -1;
+    }
+    b->len += n;
+    return handle_client_frames(client_fd, player_id);
+}
+
+// Finishes a frame split across wakeups with blocking reads, so the stream
+// is handed over on a frame boundary. A client that does not send the rest
+// within a second is dropped rather than stall the upgrade.
+// Returns -1 if the connection was closed, 0 otherwise
+int finish_client_input(int client_fd, int *player_id) {
+    InputBuf *b = &conn_input[client_fd];
+    if (b->len == 0) return 0;
+
+    struct timeval tv = { 1, 0 };
+    setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    while (b->len > 0) {
+        uint32_t need = b->len < sizeof(PacketHeader) ? sizeof(PacketHeader) : proto_frame_size(b->data);
+        uint32_t rest = need - b->len;
+        worker_metrics->io_syscalls++;
+        if (input_reserve(b, rest) < 0 || recv(client_fd, b->data + b->len, rest, MSG_WAITALL) != (ssize_t)rest) {
+            drop_client(client_fd, player_id);
+            return -1;
+        }
+        b->len = need;
+        if (handle_client_frames(client_fd, player_id) < 0) return -1;
+    }
+    tv.tv_sec = 0;
+    setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return 0;
+}
+
+// Called with the lock held
+void fill_snake_view(SnakeView *v, int player_id) {
+    Snake *s = &game_state->snakes[player_id];
+    memset(v, 0, sizeof(*v));
+    if (!game_state->active_players[player_id] || !s->alive) return;
+    v->length = s->length;
+    v->direction = s->direction;
+    for (int j = 0; j < s->length; j++) {
+        v->body[j][0] = (uint8_t)s->body[j].x;
+        v->body[j][1] = (uint8_t)s->body[j].y;
+    }
+}
+
+int open_udp_socket() {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("socket (udp)");
+        return -1;
+    }
+    int sndbuf = UDP_SNDBUF;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = 0;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &addr_len) < 0) {
+        perror("bind (udp)");
+        close(fd);
+        return -1;
+    }
+    udp_port = addr.sin_port;
+    for (int i = 0; i < MAX_PLAYERS; i++) udp_peers[i].fd = -1;
+    return fd;
+}
+
+// The player's updates go out as datagrams
+int udp_session(int fd, int player_id) {
+    UdpPeer *p = &udp_peers[player_id];
+    return udp_fd >= 0 && p->bound && p->fd == fd && p->token == game_state->player_token[player_id];
+}
+
+// Drains the datagram socket: OP_UDP_HELLO binds an address, OP_MOVE is a move
+void udp_receive(const int *client_ids) {
+    unsigned char buf[256];
+    for (int n = 0; n < 64; n++) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t r = recvfrom(udp_fd, buf, sizeof(buf), MSG_TRUNC, (struct sockaddr *)&from, &from_len);
+        worker_metrics->io_syscalls++;
+        if (r < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) perror("recvfrom");
+            return;
+        }
+        worker_metrics->udp_datagrams_in++;
+        worker_metrics->bytes_in += r;
+
+        uint16_t opcode;
+        unsigned char *payload;
+        uint32_t len;
+        UdpHeader h;
+        if ((size_t)r > sizeof(buf) || decode_packet(buf, r, &opcode, &payload, &len) != r ||
+            len < sizeof(UdpHeader)) {
+            worker_metrics->udp_drops++;
+            continue;
+        }
+        memcpy(&h, payload, sizeof(h));
+
+        UdpPeer *p = h.player_id >= 0 && h.player_id < MAX_PLAYERS ? &udp_peers[h.player_id] : NULL;
+        if (!p || p->fd < 0 || client_ids[p->fd] != h.player_id || h.token != p->token ||
+            p->token != game_state->player_token[h.player_id]) {
+            worker_metrics->udp_drops++;
+            continue;
+        }
+
+        if (opcode == OP_UDP_HELLO) {
+            // Also re-binds a client whose address changed (NAT rebinding)
+            p->addr = from;
+            p->bound = 1;
+            p->seq_in = h.seq;
+        } else if (opcode == OP_MOVE && len >= sizeof(UdpMove) && p->bound &&
+                   from.sin_addr.s_addr == p->addr.sin_addr.s_addr && from.sin_port == p->addr.sin_port &&
+                   h.seq > p->seq_in) {
+            UdpMove m;
+            memcpy(&m, payload, sizeof(m));
+            p->seq_in = h.seq;
+            // Shares the connection's buckets; abusers are dropped on their next TCP packet
+            if (ratelimit_check(&conn_limits[p->fd], &rate_limit, r, trace_now_ns()) != RATE_OK) {
+                worker_metrics->throttled++;
+                continue;
             }
+            queue_move(p->fd, h.player_id, &m.move);
+        } else {
+            worker_metrics->udp_drops++; // Reordered, duplicate or spoofed
+        }
+    }
+}
+
+// Sends the current frame to the given datagram sessions, UDP_BATCH per sendmmsg()
+void udp_send_updates(const int *fds, int n, const int *client_ids, uint64_t *client_versions) {
+    static __thread UdpUpdate *updates = NULL; // UDP_BATCH frames, plus their encodings
+    static __thread unsigned char (*bufs)[sizeof(ExtendedHeader) + sizeof(UdpUpdate)] = NULL;
+    struct mmsghdr msgs[UDP_BATCH];
+    struct iovec iovs[UDP_BATCH];
+
+    if (updates == NULL) {
+        updates = calloc(UDP_BATCH, sizeof(*updates));
+        bufs = malloc(UDP_BATCH * sizeof(*bufs));
+        if (!updates || !bufs) {
+            perror("malloc");
+            exit(1);
         }
-        pthread_mutex_unlock(&game_state->lock);
-        printf("Player %d logged out.\n", *player_id);
-        close(client_fd);
-        *player_id = -1;
     }
 
-    if (payload) free(payload);
+    for (int start = 0; start < n; start += UDP_BATCH) {
+        int count = n - start < UDP_BATCH ? n - start : UDP_BATCH;
+
+        // One lock for the whole batch; the map is copied once and fanned out after
+        game_lock(LOCK_SITE_SNAPSHOT);
+        for (int k = 0; k < count; k++) {
+            int pid = client_ids[fds[start + k]];
+            UdpUpdate *u = &updates[k];
+            u->udp.player_id = pid;
+            u->udp.token = udp_peers[pid].token;
+            u->udp.seq = ++udp_peers[pid].seq_out;
+            u->frame.header.tick = game_state->version;
+            u->frame.header.ack_seq = game_state->applied_seq[pid];
+            u->frame.header.reserved = 0;
+            fill_snake_view(&u->frame.self, pid);
+        }
+        memcpy(updates[0].frame.map, game_state->map, sizeof(game_state->map));
+        game_unlock();
+
+        memset(msgs, 0, sizeof(msgs));
+        for (int k = 0; k < count; k++) {
+            int pid = client_ids[fds[start + k]];
+            if (k > 0) memcpy(updates[k].frame.map, updates[0].frame.map, sizeof(updates[0].frame.map));
+            int len = encode_frame(bufs[k], sizeof(bufs[k]), OP_UPDATE, &updates[k], sizeof(UdpUpdate),
+                                   conn_integrity[fds[start + k]]);
+            iovs[k].iov_base = bufs[k];
+            iovs[k].iov_len = len;
+            msgs[k].msg_hdr.msg_name = &udp_peers[pid].addr;
+            msgs[k].msg_hdr.msg_namelen = sizeof(udp_peers[pid].addr);
+            msgs[k].msg_hdr.msg_iov = &iovs[k];
+            msgs[k].msg_hdr.msg_iovlen = 1;
+        }
+
+        int sent = sendmmsg(udp_fd, msgs, count, 0);
+        worker_metrics->io_syscalls++;
+        if (sent < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("sendmmsg");
+            sent = 0;
+        }
+        worker_metrics->udp_batches++;
+        worker_metrics->udp_datagrams_out += sent;
+        worker_metrics->udp_drops += count - sent;
+
+        // Latest wins: frames that did not go out are not retried, the next tick supersedes them
+        for (int k = 0; k < count; k++) {
+            int fd = fds[start + k];
+            client_versions[fd] = updates[k].frame.header.tick;
+            if (k < sent) {
+                worker_metrics->bytes_out += iovs[k].iov_len;
+                trace_event(TRACE_UPDATE_SENT, fd, updates[k].frame.header.tick);
+            }
+        }
+    }
+}
+
+// Newest spectator frame this worker copied out of the broadcast ring (select backend)
+__thread unsigned char *spec_frame = NULL;
+__thread uint64_t spec_tick = 0;
+__thread unsigned char *spec_frame_crc = NULL; // spec_frame for CRC32C spectators, built on first use
+__thread uint64_t spec_crc_tick = 0;
+
+void spectator_refresh() {
+    if (!spec_frame && !(spec_frame = malloc(BROADCAST_FRAME_SIZE))) return;
+    if (broadcast_read(&game_state->broadcast, spec_tick, spec_frame, &spec_tick) < 0) {
+        worker_metrics->broadcast_retries++;
+    }
+}
+
+// Sends spec_frame. A spectator whose socket buffer is full skips the frame
+// rather than stall the worker's players; only a frame already partly sent is
+// finished with blocking sends, to keep the stream whole.
+// Returns 1 if sent, 0 if skipped, -1 on error.
+int spectator_send(int fd) {
+    const unsigned char *frame = spec_frame;
+    size_t size = BROADCAST_FRAME_SIZE;
+    if (conn_integrity[fd] == PROTO_CRC32C) {
+        if (spec_crc_tick != spec_tick) {
+            if (!spec_frame_crc && !(spec_frame_crc = malloc(BROADCAST_CRC_FRAME_SIZE))) return -1;
+            broadcast_to_crc32c(spec_frame, spec_frame_crc);
+            spec_crc_tick = spec_tick;
+        }
+        frame = spec_frame_crc;
+        size = BROADCAST_CRC_FRAME_SIZE;
+    }
+
+    size_t sent = 0;
+    worker_metrics->io_syscalls++;
+    ssize_t n = send(fd, frame, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+    while (n > 0) {
+        sent += n;
+        if (sent == size) break;
+        worker_metrics->io_syscalls++;
+        n = send(fd, frame + sent, size - sent, MSG_NOSIGNAL);
+    }
+    if (sent < size) {
+        worker_metrics->send_errors++;
+        return -1;
+    }
+    worker_metrics->packets_out++;
+    worker_metrics->bytes_out += size;
+    worker_metrics->spectator_frames++;
+    return 1;
+}
+
+// Top of the leaderboard as of this worker's last version poll
+__thread ScoresPayload scores;
+__thread uint32_t scores_len = 0;
+
+// Called with the lock held, from the version poll
+void refresh_scores() {
+    if (game_state->leaderboard.version != scores.version) scores_len = leaderboard_snapshot(game_state, &scores);
+}
+
+// Sends OP_SCORES if this connection has not seen the current leaderboard
+void push_scores(int fd, uint64_t *seen) {
+    if (*seen >= scores.version) return;
+    *seen = scores.version;
+    if (worker_send(fd, OP_SCORES, &scores, scores_len) < 0) return;
+    worker_metrics->scores_pushed++;
+    if (uring_worker) uring_progress(fd);
+}
+
+int hand_over_client(int worker_id, int fd, int player_id, uint64_t version, time_t last_activity) {
+    HandoffMsg msg = { HANDOFF_CLIENT, worker_id, player_id, conn_integrity[fd], version, (int64_t)last_activity };
+    return handoff_send(ctl_fd, &msg, fd);
+}
+
+void hand_over_done(int worker_id, int handed) {
+    HandoffMsg done = { HANDOFF_DONE, worker_id, -1, -1, 0, 0 };
+    handoff_send(ctl_fd, &done, -1);
+    printf("Worker %d handed over %d connections.\n", worker_id, handed);
+    exit(0);
+}
+
+// Upgrade: pass every client connection to the master, then exit without
+// touching their players; the new master's worker of the same slot adopts them.
+void worker_hand_over(int worker_id, fd_set *fds, int max_fd, int *client_ids,
+                      uint64_t *client_versions, time_t *client_last_activity) {
+    int handed = 0;
+    for (int i = 0; i <= max_fd; i++) {
+        if (i == server_fd || i == ctl_fd || i == udp_fd || !FD_ISSET(i, fds)) continue;
+        if (finish_client_input(i, &client_ids[i]) < 0) FD_CLR(i, fds);
+    }
+    flush_moves();
+    for (int i = 0; i <= max_fd; i++) {
+        if (i == server_fd || i == ctl_fd || i == udp_fd || !FD_ISSET(i, fds)) continue;
+        if (hand_over_client(worker_id, i, client_ids[i], client_versions[i], client_last_activity[i]) == 0) handed++;
+    }
+    hand_over_done(worker_id, handed);
 }
 
 void worker_process(int worker_id) {
@@ -281,17 +973,54 @@ void worker_process(int worker_id) {
     int client_ids[FD_SETSIZE]; // Map fd to player_id
     uint64_t client_versions[FD_SETSIZE]; // Track last sent version
     time_t client_last_activity[FD_SETSIZE]; // Track last activity for timeout
+    uint64_t client_scores[FD_SETSIZE]; // Leaderboard version sent
 
     for (int i = 0; i < FD_SETSIZE; i++) {
         client_ids[i] = -1;
         client_versions[i] = 0;
         client_last_activity[i] = 0;
+        client_scores[i] = 0;
     }
 
+    current_worker = worker_id;
+    worker_metrics = &game_state->metrics.workers[worker_id];
+    alloc_conn_state();
+
     FD_ZERO(&masterfds);
     FD_SET(server_fd, &masterfds);
+    if (ctl_fd >= 0) FD_SET(ctl_fd, &masterfds);
+    if (ctl_fd > max_fd) max_fd = ctl_fd;
+
+    // Inherited connections fall back to TCP updates: their UDP sessions were bound to the old worker's port
+    udp_fd = open_udp_socket();
+    if (udp_fd >= 0) {
+        FD_SET(udp_fd, &masterfds);
+        if (udp_fd > max_fd) max_fd = udp_fd;
+    }
+
+    if (io_backend == IO_BACKEND_URING) {
+        worker_loop_uring(worker_id); // Returns only if io_uring is unavailable
+        printf("Worker %d: falling back to select().\n", worker_id);
+    }
+
+    // Connections handed over by the previous master (hot upgrade)
+    for (int k = 0; k < num_inherited; k++) {
+        InheritedClient *c = &inherited[k];
+        if (c->msg.worker != worker_id) {
+            close(c->fd);
+            continue;
+        }
+        FD_SET(c->fd, &masterfds);
+        if (c->fd > max_fd) max_fd = c->fd;
+        client_ids[c->fd] = c->msg.player_id;
+        client_versions[c->fd] = c->msg.version;
+        client_last_activity[c->fd] = (time_t)c->msg.last_activity;
+        conn_integrity[c->fd] = c->msg.arg == PROTO_CRC32C ? PROTO_CRC32C : PROTO_SUM;
+    }
+    num_inherited = 0;
 
     printf("Worker %d started.\n", worker_id);
+    trace_event(TRACE_PROC_START, TRACE_ROLE_WORKER, worker_id);
 
     while (1) {
         readfds = masterfds;
@@ -300,6 +1029,7 @@ void worker_process(int worker_id) {
         timeout.tv_usec = 50000; // 50ms
 
         int activity = select(max_fd + 1, &readfds, NULL, NULL, &timeout);
+        worker_metrics->io_syscalls++;
 
         if (activity == -1) {
             if (errno == EINTR) continue;
@@ -311,61 +1041,84 @@ void worker_process(int worker_id) {
 
         // Check for timeouts and updates to send
         uint64_t current_version = 0;
-        pthread_mutex_lock(&game_state->lock);
+        game_lock(LOCK_SITE_VERSION);
         current_version = game_state->version;
-        pthread_mutex_unlock(&game_state->lock);
+        refresh_scores();
+        game_unlock();
+        spectator_refresh();
+
+        int udp_due[FD_SETSIZE]; // Datagram sessions needing this frame
+        int num_udp_due = 0;
 
         for (int i = 0; i <= max_fd; i++) {
-            if (i != server_fd && FD_ISSET(i, &masterfds)) {
+            if (i != server_fd && i != ctl_fd && i != udp_fd && FD_ISSET(i, &masterfds)) {
                 // Check for client timeout
                 if (client_last_activity[i] > 0 && 
                     (now - client_last_activity[i]) > CLIENT_TIMEOUT_SEC) {
-                    printf("Worker %d: Client fd %d timed out.\n", worker_id, i);
+                    if (verbose) printf("Worker %d: Client fd %d timed out.\n", worker_id, i);
+                    trace_event(TRACE_TIMEOUT, client_ids[i], i);
+                    worker_metrics->timeouts++;
                     if (client_ids[i] >= 0) {
-                        pthread_mutex_lock(&game_state->lock);
-                        game_state->active_players[client_ids[i]] = 0;
-                        for(int y=0; y<MAP_HEIGHT; y++) {
-                            for(int x=0; x<MAP_WIDTH; x++) {
-                                if(game_state->map[y][x] == CELL_PLAYER_BASE + client_ids[i]) {
-                                    game_state->map[y][x] = CELL_EMPTY;
-                                }
-                            }
-                        }
-                        pthread_mutex_unlock(&game_state->lock);
+                        game_lock(LOCK_SITE_CLEANUP);
+                        game_remove_player(game_state, client_ids[i]);
+                        record_input(REC_REMOVE, client_ids[i], 0, 0);
+                        game_unlock();
                     }
-                    close(i);
+                    worker_close_client(i, client_ids[i]);
                     FD_CLR(i, &masterfds);
                     client_ids[i] = -1;
                     client_last_activity[i] = 0;
                     continue;
                 }
 
-                if (client_ids[i] != -1) {
+                if (client_ids[i] == SPECTATOR_ID) {
+                    if (client_versions[i] < spec_tick) {
+                        int sent = spectator_send(i);
+                        if (sent > 0) {
+                            if (client_versions[i] > 0) worker_metrics->spectator_skips += spec_tick - client_versions[i] - 1;
+                            client_versions[i] = spec_tick;
+                        } else if (sent < 0) {
+                            trace_event(TRACE_SEND_FAIL, i, OP_UPDATE);
+                        }
+                    }
+                    push_scores(i, &client_scores[i]);
+                } else if (client_ids[i] != -1) {
                     // Check if player is dead
                     if (game_state->active_players[client_ids[i]] == 0) {
-                         send_packet(i, OP_DIE, NULL, 0);
-                         close(i);
+                         worker_send(i, OP_DIE, NULL, 0);
+                         worker_close_client(i, client_ids[i]);
                          FD_CLR(i, &masterfds);
                          client_ids[i] = -1;
                          client_last_activity[i] = 0;
                          continue;
                     }
 
-                    if (client_versions[i] < current_version) {
-                        int map_copy[MAP_HEIGHT][MAP_WIDTH];
-                        pthread_mutex_lock(&game_state->lock);
-                        memcpy(map_copy, game_state->map, sizeof(game_state->map));
-                        pthread_mutex_unlock(&game_state->lock);
+                    if (client_versions[i] < current_version && udp_session(i, client_ids[i])) {
+                        udp_due[num_udp_due++] = i;
+                    } else if (client_versions[i] < current_version) {
+                        UpdateFrame frame;
+                        memset(&frame, 0, sizeof(frame)); // The tail padding goes out too
+                        game_lock(LOCK_SITE_SNAPSHOT);
+                        frame.header.tick = game_state->version;
+                        frame.header.ack_seq = game_state->applied_seq[client_ids[i]];
+                        frame.header.reserved = 0;
+                        fill_snake_view(&frame.self, client_ids[i]);
+                        memcpy(frame.map, game_state->map, sizeof(game_state->map));
+                        game_unlock();
                         
-                        if (send_packet(i, OP_UPDATE, map_copy, sizeof(map_copy)) == -1) {
+                        if (worker_send(i, OP_UPDATE, &frame, sizeof(frame)) == -1) {
                              // Error sending, maybe close?
+                             trace_event(TRACE_SEND_FAIL, i, OP_UPDATE);
                         } else {
-                            client_versions[i] = current_version;
+                            client_versions[i] = frame.header.tick;
+                            trace_event(TRACE_UPDATE_SENT, i, frame.header.tick);
                         }
                     }
+                    push_scores(i, &client_scores[i]);
                 }
             }
         }
+        if (num_udp_due > 0) udp_send_updates(udp_due, num_udp_due, client_ids, client_versions);
 
         if (activity > 0) {
             for (int i = 0; i <= max_fd; i++) {
@@ -375,108 +1128,1325 @@ void worker_process(int worker_id) {
                         struct sockaddr_in client_addr;
                         socklen_t addr_len = sizeof(client_addr);
                         int new_fd = accept(server_fd, (struct sockaddr *)&client_addr, &addr_len);
+                        worker_metrics->io_syscalls++;
                         if (new_fd == -1) {
-                            perror("accept");
+                            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept");
                         } else {
                             FD_SET(new_fd, &masterfds);
                             if (new_fd > max_fd) max_fd = new_fd;
                             client_last_activity[new_fd] = time(NULL);
-                            printf("Worker %d accepted new connection (fd=%d).\n", worker_id, new_fd);
+                            client_scores[new_fd] = 0;
+                            worker_metrics->accepts++;
+                            worker_metrics->connections++;
+                            if (verbose) printf("Worker %d accepted new connection (fd=%d).\n", worker_id, new_fd);
+                            trace_event(TRACE_ACCEPT, new_fd, worker_id);
+                        }
+                    } else if (i == udp_fd) {
+                        udp_receive(client_ids);
+                    } else if (i == ctl_fd) {
+                        HandoffMsg msg;
+                        int fd;
+                        if (handoff_recv(ctl_fd, &msg, &fd) < 0) {
+                            // Master is gone; keep serving what we have
+                            FD_CLR(ctl_fd, &masterfds);
+                            close(ctl_fd);
+                            ctl_fd = -1;
+                        } else if (msg.type == HANDOFF_START) {
+                            worker_hand_over(worker_id, &masterfds, max_fd, client_ids,
+                                             client_versions, client_last_activity);
                         }
                     } else {
                         // Handle client data
                         int pid = client_ids[i];
-                        handle_client_message(i, &pid);
+                        int closed = handle_client_input(i, &pid);
                         client_ids[i] = pid; // Update ID (in case of login)
                         client_last_activity[i] = time(NULL);  // Update last activity
                         
-                        if (pid == -1 && client_ids[i] == -1) { 
-                            // Disconnected or died
+                        if (closed) { 
+                            // Disconnected, logged out or rejected
                             FD_CLR(i, &masterfds);
                             client_last_activity[i] = 0;
                         }
                     }
                 }
             }
+            flush_moves();
         }
     }
 }
 
-int main() {
-    signal(SIGINT, handle_sigint);
+// io_uring worker backend (-io uring). Same protocol handling as the select()
+// loop, but all socket I/O goes through one ring: a multishot accept, one
+// multishot recv per connection into provided buffers, and sends queued as
+// SQEs. Everything queued while handling completions and building a tick's
+// updates goes to the kernel in the next single io_uring_enter().
+
+#define URING_ENTRIES 1024
+#define URING_MAX_FDS MAX_CONN_FDS
+#define URING_RECV_BUFS 512      // Provided recv buffers, power of two
+#define URING_RECV_BUF_SIZE INPUT_CHUNK // So one recv fits within INPUT_MAX
+#define URING_BGID 1
+#define URING_MAP_SLOTS 4        // Encrypted maps of recent ticks, registered buffers
+#define URING_SPEC_SLOTS 4       // Broadcast frames being sent to spectators, registered after the maps
+#define URING_WAIT_MS 50         // Same period as the select() timeout
+#define URING_ACCEPT_BATCH 16    // Accepts before a worker re-queues its multishot accept
+
+// user_data: kind << 56 | slot << 48 | fd
+#define UD_ACCEPT    1
+#define UD_RECV      2
+#define UD_SEND_HEAD 3
+#define UD_SEND_MAP  4
+#define UD_SEND_OUT  5
+#define UD_POLL_UDP  6
+#define UD_POLL_CTL  7
+#define UD_CANCEL    8
+#define UD_SEND_SPEC 9
+#define UD(kind, slot, fd) ((uint64_t)(kind) << 56 | (uint64_t)(slot) << 48 | (uint32_t)(fd))
+
+// UpdateFrame up to the map: the part of an update that differs per client
+#define UPDATE_HEAD_SIZE offsetof(UpdateFrame, map)
+// Where it starts in UringConn.head: the frame header, of either size, goes right before it
+#define UPDATE_HEAD_OFFSET 16
+// The rest of the frame: the map and the struct's tail padding, the same for every client
+#define UPDATE_TAIL_SIZE (sizeof(UpdateFrame) - offsetof(UpdateFrame, map))
 
-    // Create Shared Memory
-    key_t key = ftok(SHM_KEY_FILE, SHM_KEY_ID);
-    shmid = shmget(key, sizeof(GameState), 0666 | IPC_CREAT);
-    if (shmid == -1) {
-        perror("shmget");
+typedef struct {
+    int open;
+    int closing;        // No more input or updates; shut down once queued replies are out
+    int shut;           // shutdown() done, waiting for the ring to let go of the fd
+    int recv_armed;
+    int inflight;       // Send CQEs (and zero-copy notifications) still to come
+    time_t last_activity;
+    InputBuf in;
+    unsigned char *out[2]; // [0] in flight, [1] replies queued meanwhile
+    uint32_t out_len[2], out_cap[2];
+    unsigned char head[UPDATE_HEAD_OFFSET + UPDATE_HEAD_SIZE] __attribute__((aligned(8)));
+    uint32_t head_sent;    // Bytes of head in the current UD_SEND_HEAD
+} UringConn;
+
+// One tick's map, encrypted once and sent to every client with a fixed-buffer
+// zero-copy send linked after the client's own head. The additive checksum
+// lets the head's sum and the map's sum be computed separately, and the
+// CRC32C of the whole payload is combined from the two parts' CRCs.
+typedef struct {
+    unsigned char map[UPDATE_TAIL_SIZE];
+    uint64_t tick;     // 0 = empty
+    uint16_t sum;      // calculate_checksum() of the plain map
+    uint32_t crc;      // crc32c() of the encrypted map, if crc_ready
+    int crc_ready;
+    int refs;          // Sends in flight from this slot
+} MapSlot;
+
+__thread Uring ring;
+__thread UringBufRing recv_ring;
+// A broadcast ring frame copied out for spectators, kept until every
+// zero-copy send from it has completed
+typedef struct {
+    unsigned char data[BROADCAST_FRAME_SIZE];
+    unsigned char crc_data[BROADCAST_CRC_FRAME_SIZE]; // The same for CRC32C spectators, if crc_ready
+    uint64_t tick;
+    int crc_ready;
+    int refs;
+} SpecSlot;
+
+__thread UringConn *uconns;
+__thread int *uconn_ids;            // fd -> player_id, the select loop's client_ids
+__thread uint64_t *uconn_versions;  // fd -> last version sent
+__thread int uconn_max_fd = -1;
+__thread int uring_draining = 0;    // Handing over: recvs are being cancelled
+__thread int uring_accepted = 0;    // Accepts since the multishot accept was armed
+__thread MapSlot *map_slots;        // URING_MAP_SLOTS
+__thread uint32_t map_crc_op;       // crc32c_combine_op(UPDATE_TAIL_SIZE)
+__thread SpecSlot *spec_slots;      // URING_SPEC_SLOTS
+__thread SpecSlot *spec_latest;     // Newest frame copied, NULL before the first
+__thread uint64_t *uconn_scores;    // fd -> leaderboard version sent
+
+struct io_uring_sqe *uring_sqe() {
+    struct io_uring_sqe *sqe = uring_get_sqe(&ring);
+    if (!sqe) {
+        perror("io_uring_enter");
         exit(1);
     }
+    return sqe;
+}
 
-    game_state = (GameState *)shmat(shmid, NULL, 0);
-    if (game_state == (void *)-1) {
-        perror("shmat");
+void uring_arm_accept() {
+    uring_accepted = 0;
+    struct io_uring_sqe *sqe = uring_sqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = server_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = UD(UD_ACCEPT, 0, server_fd);
+}
+
+void uring_arm_poll(int fd, int kind) {
+    struct io_uring_sqe *sqe = uring_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = UD(kind, 0, fd);
+}
+
+void uring_arm_recv(int fd) {
+    struct io_uring_sqe *sqe = uring_sqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BGID;
+    sqe->user_data = UD(UD_RECV, 0, fd);
+    uconns[fd].recv_armed = 1;
+}
+
+void uring_cancel(uint64_t user_data) {
+    struct io_uring_sqe *sqe = uring_sqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = user_data;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = UD(UD_CANCEL, 0, 0);
+}
+
+void uring_add_conn(int fd, int player_id, uint64_t version, time_t last_activity) {
+    UringConn *c = &uconns[fd];
+    memset(c, 0, sizeof(*c));
+    c->open = 1;
+    c->last_activity = last_activity;
+    uconn_ids[fd] = player_id;
+    uconn_versions[fd] = version;
+    uconn_scores[fd] = 0;
+    if (fd > uconn_max_fd) uconn_max_fd = fd;
+    uring_arm_recv(fd);
+}
+
+// worker_send() in this backend: replies are queued and sent in order after
+// whatever is in flight on the connection
+int uring_queue_reply(int fd, uint16_t opcode, const void *payload, uint32_t len) {
+    UringConn *c = &uconns[fd];
+    uint32_t need = c->out_len[1] + proto_header_size(conn_integrity[fd]) + len;
+    if (need > c->out_cap[1]) {
+        uint32_t cap = c->out_cap[1] ? c->out_cap[1] : 512;
+        while (cap < need) cap *= 2;
+        unsigned char *buf = realloc(c->out[1], cap);
+        if (!buf) {
+            worker_metrics->send_errors++;
+            return -1;
+        }
+        c->out[1] = buf;
+        c->out_cap[1] = cap;
+    }
+    c->out_len[1] += encode_frame(c->out[1] + c->out_len[1], c->out_cap[1] - c->out_len[1],
+                                  opcode, payload, len, conn_integrity[fd]);
+    worker_metrics->packets_out++;
+    worker_metrics->bytes_out += proto_header_size(conn_integrity[fd]) + len;
+    return 0;
+}
+
+// Stops serving the connection; the fd is closed once the ring is done with it
+void uring_drop_conn(int fd) {
+    UringConn *c = &uconns[fd];
+    if (c->closing) return;
+    c->closing = 1;
+    worker_metrics->connections--;
+    if (uconn_ids[fd] >= 0) worker_metrics->players--;
+    if (uconn_ids[fd] == SPECTATOR_ID) worker_metrics->spectators--;
+    uconn_ids[fd] = -1;
+    reset_conn_state(fd);
+    uring_progress(fd);
+}
+
+// Peer went away (EOF, error, timeout, broken stream): same cleanup as the select loop
+void uring_disconnect(int fd) {
+    int player_id = uconn_ids[fd];
+    if (uconns[fd].closing) return;
+    worker_metrics->disconnects++;
+    if (player_id >= 0) {
+        game_lock(LOCK_SITE_CLEANUP);
+        game_remove_player(game_state, player_id);
+        record_input(REC_REMOVE, player_id, 0, 0);
+        game_unlock();
+        if (verbose) printf("Player %d disconnected.\n", player_id);
+        trace_event(TRACE_DISCONNECT, player_id, fd);
+    }
+    uring_drop_conn(fd);
+}
+
+// Starts the next send if the connection is idle, and retires closed connections
+void uring_progress(int fd) {
+    UringConn *c = &uconns[fd];
+    if (!c->open) return;
+
+    if (c->inflight == 0 && c->out_len[1] > 0 && !c->shut) {
+        unsigned char *buf = c->out[0];
+        uint32_t cap = c->out_cap[0];
+        c->out[0] = c->out[1];
+        c->out_cap[0] = c->out_cap[1];
+        c->out_len[0] = c->out_len[1];
+        c->out[1] = buf;
+        c->out_cap[1] = cap;
+        c->out_len[1] = 0;
+
+        struct io_uring_sqe *sqe = uring_sqe();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)(uintptr_t)c->out[0];
+        sqe->len = c->out_len[0];
+        sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+        sqe->user_data = UD(UD_SEND_OUT, 0, fd);
+        c->inflight++;
+        return;
+    }
+    if (c->closing && !c->shut && c->inflight == 0) {
+        shutdown(fd, SHUT_RDWR); // Completes the multishot recv
+        c->shut = 1;
+    }
+    if (c->shut && c->inflight == 0 && !c->recv_armed) {
+        close(fd);
+        free(c->in.data);
+        free(c->out[0]);
+        free(c->out[1]);
+        memset(c, 0, sizeof(*c));
+    }
+}
+
+void uring_input(int fd, const unsigned char *data, uint32_t n) {
+    UringConn *c = &uconns[fd];
+    c->last_activity = time(NULL);
+
+    InputBuf *b = &c->in;
+    if (input_reserve(b, n) < 0) {
+        uring_disconnect(fd);
+        return;
+    }
+    memcpy(b->data + b->len, data, n);
+    b->len += n;
+
+    uint32_t off = 0;
+    while (!c->closing) {
+        uint16_t opcode;
+        unsigned char *payload;
+        uint32_t len;
+        int integrity;
+        int r = decode_frame(b->data + off, b->len - off, &opcode, &payload, &len, &integrity);
+        if (r == 0) break;
+        if (r < 0) {
+            uring_disconnect(fd); // Malformed or corrupt
+            return;
+        }
+        off += r;
+
+        int pid = uconn_ids[fd];
+        conn_integrity[fd] = integrity;
+        int closed = handle_packet(fd, &pid, opcode, payload, len);
+        uconn_ids[fd] = pid;
+        if (closed) uring_drop_conn(fd); // Queued replies (e.g. "Server Full") still go out
+    }
+    if (c->closing) return; // The rest is never read
+    if (input_consume(b, off) < 0) uring_disconnect(fd);
+}
+
+// Queues the current frame to the given connections: one lock, one map copy
+// and encryption per tick, then per client a linked pair of sends: its own
+// head from the connection, and the shared map from a registered buffer.
+void uring_send_updates(const int *fds, int n) {
+    MapSlot *slot = NULL;
+
+    game_lock(LOCK_SITE_SNAPSHOT);
+    uint64_t tick = game_state->version;
+    for (int i = 0; i < URING_MAP_SLOTS && !slot; i++) {
+        if (map_slots[i].tick == tick) slot = &map_slots[i];
+    }
+    int fresh = 0;
+    for (int i = 0; i < URING_MAP_SLOTS && !slot; i++) {
+        if (map_slots[i].refs == 0) {
+            slot = &map_slots[i];
+            memcpy(slot->map, game_state->map, sizeof(game_state->map)); // Padding stays zero
+            slot->tick = tick;
+            fresh = 1;
+        }
+    }
+    if (!slot) {
+        // Every slot is still being sent from; slow clients get the next tick
+        game_unlock();
+        return;
+    }
+    for (int k = 0; k < n; k++) {
+        int pid = uconn_ids[fds[k]];
+        unsigned char *head = uconns[fds[k]].head + UPDATE_HEAD_OFFSET;
+        UpdateHeader *h = (UpdateHeader *)head;
+        h->tick = tick;
+        h->ack_seq = game_state->applied_seq[pid];
+        h->reserved = 0;
+        fill_snake_view((SnakeView *)(head + offsetof(UpdateFrame, self)), pid);
+    }
+    game_unlock();
+
+    if (fresh) {
+        slot->sum = calculate_checksum(slot->map, sizeof(slot->map));
+        xor_cipher(slot->map, sizeof(slot->map));
+        slot->crc_ready = 0;
+    }
+
+    for (int k = 0; k < n; k++) {
+        int fd = fds[k];
+        UringConn *c = &uconns[fd];
+        unsigned char *payload = c->head + UPDATE_HEAD_OFFSET;
+        int integrity = conn_integrity[fd];
+        size_t header_len = proto_header_size(integrity);
+        unsigned char *frame = payload - header_len;
+
+        ExtendedHeader eh;
+        eh.base.length = htonl(sizeof(UpdateFrame));
+        eh.base.opcode = htons(OP_UPDATE);
+        eh.base.checksum = htons((uint16_t)(calculate_checksum(payload, UPDATE_HEAD_SIZE) + slot->sum));
+        xor_cipher(payload, UPDATE_HEAD_SIZE);
+        if (integrity == PROTO_CRC32C) {
+            if (!slot->crc_ready) {
+                slot->crc = crc32c(0, slot->map, sizeof(slot->map));
+                slot->crc_ready = 1;
+            }
+            eh.base.opcode = htons(OP_UPDATE | OP_FLAG_CRC32C);
+            eh.base.checksum = 0;
+            eh.crc32c = htonl(crc32c_combine(crc32c(0, payload, UPDATE_HEAD_SIZE), slot->crc, map_crc_op));
+        }
+        memcpy(frame, &eh, header_len);
+        c->head_sent = header_len + UPDATE_HEAD_SIZE;
+
+        struct io_uring_sqe *sqe = uring_sqe();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)(uintptr_t)frame;
+        sqe->len = c->head_sent;
+        sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+        sqe->flags = IOSQE_IO_LINK;
+        sqe->user_data = UD(UD_SEND_HEAD, 0, fd);
+
+        sqe = uring_sqe();
+        sqe->opcode = IORING_OP_SEND_ZC;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)(uintptr_t)slot->map;
+        sqe->len = sizeof(slot->map);
+        sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+        sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+        sqe->buf_index = (uint16_t)(slot - map_slots);
+        sqe->user_data = UD(UD_SEND_MAP, slot - map_slots, fd);
+
+        c->inflight += 2;
+        slot->refs++;
+        uconn_versions[fd] = tick;
+        worker_metrics->packets_out++;
+        worker_metrics->bytes_out += header_len + sizeof(UpdateFrame);
+        trace_event(TRACE_UPDATE_SENT, fd, tick);
+    }
+}
+
+// Copies a newer broadcast frame, if any, into a slot no send is using
+void uring_spectator_refresh() {
+    SpecSlot *slot = NULL;
+    for (int i = 0; i < URING_SPEC_SLOTS && !slot; i++) {
+        if (spec_slots[i].refs == 0 && &spec_slots[i] != spec_latest) slot = &spec_slots[i];
+    }
+    if (!slot) return; // All busy with slow spectators; they get a later tick
+    int r = broadcast_read(&game_state->broadcast, spec_latest ? spec_latest->tick : 0, slot->data, &slot->tick);
+    if (r > 0) {
+        slot->crc_ready = 0;
+        spec_latest = slot;
+    }
+    else if (r < 0) worker_metrics->broadcast_retries++;
+}
+
+// One zero-copy send of the shared frame per spectator; no game lock
+void uring_send_spectators(const int *fds, int n) {
+    SpecSlot *slot = spec_latest;
+    int index = (int)(slot - spec_slots);
+    for (int k = 0; k < n; k++) {
+        int fd = fds[k];
+        int crc = conn_integrity[fd] == PROTO_CRC32C;
+        if (crc && !slot->crc_ready) {
+            broadcast_to_crc32c(slot->data, slot->crc_data);
+            slot->crc_ready = 1;
+        }
+        struct io_uring_sqe *sqe = uring_sqe();
+        sqe->opcode = IORING_OP_SEND_ZC;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)(uintptr_t)(crc ? slot->crc_data : slot->data);
+        sqe->len = crc ? sizeof(slot->crc_data) : sizeof(slot->data);
+        sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+        sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+        sqe->buf_index = (uint16_t)(URING_MAP_SLOTS + (crc ? URING_SPEC_SLOTS : 0) + index);
+        sqe->user_data = UD(UD_SEND_SPEC, index, fd);
+
+        uconns[fd].inflight++;
+        slot->refs++;
+        if (uconn_versions[fd] > 0) worker_metrics->spectator_skips += slot->tick - uconn_versions[fd] - 1;
+        uconn_versions[fd] = slot->tick;
+        worker_metrics->packets_out++;
+        worker_metrics->bytes_out += sqe->len;
+        worker_metrics->spectator_frames++;
+    }
+}
+
+// Returns 1 if the master asked for a hand over
+int uring_control(int more) {
+    HandoffMsg msg;
+    int fd;
+    if (handoff_recv(ctl_fd, &msg, &fd) < 0) {
+        // Master is gone; keep serving what we have
+        uring_cancel(UD(UD_POLL_CTL, 0, ctl_fd));
+        close(ctl_fd);
+        ctl_fd = -1;
+        return 0;
+    }
+    if (!more) uring_arm_poll(ctl_fd, UD_POLL_CTL);
+    return msg.type == HANDOFF_START;
+}
+
+void uring_handle_cqe(const struct io_uring_cqe *cqe, int worker_id) {
+    int kind = (int)(cqe->user_data >> 56);
+    int slot = (int)(cqe->user_data >> 48) & 0xFF;
+    int fd = (int)(cqe->user_data & 0xFFFFFFFF);
+    int more = cqe->flags & IORING_CQE_F_MORE;
+    UringConn *c = &uconns[fd];
+
+    switch (kind) {
+    case UD_ACCEPT:
+        if (cqe->res >= 0 && cqe->res >= URING_MAX_FDS) {
+            close(cqe->res);
+        } else if (cqe->res >= 0) {
+            uring_add_conn(cqe->res, -1, 0, time(NULL));
+            worker_metrics->accepts++;
+            worker_metrics->connections++;
+            if (verbose) printf("Worker %d accepted new connection (fd=%d).\n", worker_id, cqe->res);
+            trace_event(TRACE_ACCEPT, cqe->res, worker_id);
+            // A multishot accept keeps its place at the head of the listener's
+            // wait queue and would take every connection; re-arming moves this
+            // worker to the back so the workers share new connections.
+            if (++uring_accepted == URING_ACCEPT_BATCH && more) uring_cancel(UD(UD_ACCEPT, 0, server_fd));
+        } else if (cqe->res != -EAGAIN && cqe->res != -EINTR && cqe->res != -ECANCELED) {
+            // -ECANCELED is our own re-arm (or drain) cancelling it
+            fprintf(stderr, "accept: %s\n", strerror(-cqe->res));
+        }
+        if (!more && !uring_draining) uring_arm_accept();
+        break;
+
+    case UD_RECV:
+        if (!more) c->recv_armed = 0;
+        if (cqe->res > 0) {
+            uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+            if (!c->closing) uring_input(fd, uring_buf(&recv_ring, bid), cqe->res);
+            uring_buf_ring_recycle(&recv_ring, bid);
+            if (!more && !c->closing && !uring_draining) uring_arm_recv(fd);
+        } else if (cqe->res == -ENOBUFS) {
+            // Out of provided buffers; they come back as completions are handled
+            if (!c->closing && !uring_draining) uring_arm_recv(fd);
+        } else if (!(uring_draining && cqe->res == -ECANCELED)) {
+            uring_disconnect(fd);
+        }
+        uring_progress(fd);
+        break;
+
+    case UD_SEND_HEAD:
+        c->inflight--;
+        if (cqe->res != (int)c->head_sent) uring_disconnect(fd); // Stream is torn
+        uring_progress(fd);
+        break;
+
+    case UD_SEND_MAP:
+        // Zero-copy: the result CQE has F_MORE if a notification CQE follows
+        // once the kernel no longer references the slot
+        if (!(cqe->flags & IORING_CQE_F_NOTIF) && cqe->res != (int)sizeof(map_slots[0].map)) {
+            uring_disconnect(fd);
+        }
+        if (!more) {
+            c->inflight--;
+            map_slots[slot].refs--;
+        }
+        uring_progress(fd);
+        break;
+
+    case UD_SEND_SPEC:
+        if (!(cqe->flags & IORING_CQE_F_NOTIF) &&
+            cqe->res != (int)(conn_integrity[fd] == PROTO_CRC32C ? BROADCAST_CRC_FRAME_SIZE : BROADCAST_FRAME_SIZE)) {
+            uring_disconnect(fd);
+        }
+        if (!more) {
+            c->inflight--;
+            spec_slots[slot].refs--;
+        }
+        uring_progress(fd);
+        break;
+
+    case UD_SEND_OUT:
+        c->inflight--;
+        if (cqe->res != (int)c->out_len[0]) uring_disconnect(fd);
+        c->out_len[0] = 0;
+        uring_progress(fd);
+        break;
+
+    case UD_POLL_UDP:
+        udp_receive(uconn_ids);
+        if (!more) uring_arm_poll(udp_fd, UD_POLL_UDP);
+        break;
+    }
+}
+
+// Reaps completions; returns 1 if the master asked for a hand over
+int uring_reap(int worker_id) {
+    int hand_over = 0;
+    struct io_uring_cqe *cqe;
+    while ((cqe = uring_peek_cqe(&ring)) != NULL) {
+        struct io_uring_cqe done = *cqe;
+        uring_cqe_seen(&ring);
+        if ((int)(done.user_data >> 56) == UD_POLL_CTL) {
+            if (ctl_fd >= 0 && done.res > 0) hand_over |= uring_control(done.flags & IORING_CQE_F_MORE);
+        } else {
+            uring_handle_cqe(&done, worker_id);
+        }
+    }
+    return hand_over;
+}
+
+// Upgrade: stop reading, let in-flight sends finish, then pass every
+// connection on like the select loop. A connection in the middle of a
+// packet cannot be resumed by the new worker and is dropped instead.
+void uring_hand_over(int worker_id) {
+    uring_draining = 1;
+    uring_cancel(UD(UD_ACCEPT, 0, server_fd));
+    for (int fd = 0; fd <= uconn_max_fd; fd++) {
+        if (uconns[fd].open && uconns[fd].recv_armed) uring_cancel(UD(UD_RECV, 0, fd));
+    }
+
+    time_t deadline = time(NULL) + 1;
+    while (time(NULL) <= deadline) {
+        int busy = 0;
+        for (int fd = 0; fd <= uconn_max_fd; fd++) {
+            UringConn *c = &uconns[fd];
+            if (!c->open) continue;
+            uring_progress(fd);
+            if (c->recv_armed || c->inflight > 0 || c->out_len[1] > 0) busy++;
+        }
+        if (!busy) break;
+        uring_submit(&ring, 1, URING_WAIT_MS);
+        uring_reap(worker_id);
+    }
+
+    int handed = 0;
+    for (int fd = 0; fd <= uconn_max_fd; fd++) {
+        UringConn *c = &uconns[fd];
+        if (!c->open || c->closing) continue;
+        if (c->in.len > 0 || c->inflight > 0 || c->recv_armed) {
+            uring_disconnect(fd);
+        } else if (hand_over_client(worker_id, fd, uconn_ids[fd], uconn_versions[fd], c->last_activity) == 0) {
+            handed++;
+        }
+    }
+    hand_over_done(worker_id, handed);
+}
+
+// Runs the worker on io_uring. Returns only if the kernel lacks what it
+// needs, for the caller to fall back to the select() loop.
+void worker_loop_uring(int worker_id) {
+    static const int ops[] = { IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND, IORING_OP_SEND_ZC,
+                               IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL };
+    if (uring_init(&ring, URING_ENTRIES) < 0) {
+        perror("io_uring_setup");
+        return;
+    }
+
+    map_slots = calloc(URING_MAP_SLOTS, sizeof(MapSlot));
+    map_crc_op = crc32c_combine_op(UPDATE_TAIL_SIZE);
+    spec_slots = calloc(URING_SPEC_SLOTS, sizeof(SpecSlot));
+    if (!map_slots || !spec_slots) {
+        perror("malloc");
+        exit(1);
+    }
+    struct iovec iov[URING_MAP_SLOTS + 2 * URING_SPEC_SLOTS];
+    for (int i = 0; i < URING_MAP_SLOTS; i++) {
+        iov[i].iov_base = map_slots[i].map;
+        iov[i].iov_len = sizeof(map_slots[i].map);
+    }
+    for (int i = 0; i < URING_SPEC_SLOTS; i++) {
+        iov[URING_MAP_SLOTS + i].iov_base = spec_slots[i].data;
+        iov[URING_MAP_SLOTS + i].iov_len = sizeof(spec_slots[i].data);
+        iov[URING_MAP_SLOTS + URING_SPEC_SLOTS + i].iov_base = spec_slots[i].crc_data;
+        iov[URING_MAP_SLOTS + URING_SPEC_SLOTS + i].iov_len = sizeof(spec_slots[i].crc_data);
+    }
+    if (uring_probe(&ring, ops, sizeof(ops) / sizeof(ops[0])) < 0 ||
+        uring_register_buffers(&ring, iov, URING_MAP_SLOTS + 2 * URING_SPEC_SLOTS) < 0 ||
+        uring_setup_buf_ring(&ring, &recv_ring, URING_BGID, URING_RECV_BUFS, URING_RECV_BUF_SIZE) < 0) {
+        fprintf(stderr, "Worker %d: kernel lacks io_uring features (multishot, zero-copy send, buffer rings)\n",
+                worker_id);
+        uring_exit(&ring);
+        free(map_slots);
+        free(spec_slots);
+        return;
+    }
+
+    uconns = calloc(URING_MAX_FDS, sizeof(UringConn));
+    uconn_ids = malloc(URING_MAX_FDS * sizeof(int));
+    uconn_versions = calloc(URING_MAX_FDS, sizeof(uint64_t));
+    uconn_scores = calloc(URING_MAX_FDS, sizeof(uint64_t));
+    int *tcp_due = malloc(URING_MAX_FDS * sizeof(int));
+    int *udp_due = malloc(URING_MAX_FDS * sizeof(int));
+    int *spec_due = malloc(URING_MAX_FDS * sizeof(int));
+    if (!uconns || !uconn_ids || !uconn_versions || !uconn_scores || !tcp_due || !udp_due || !spec_due) {
+        perror("malloc");
         exit(1);
     }
+    for (int i = 0; i < URING_MAX_FDS; i++) uconn_ids[i] = -1;
+    uring_worker = 1;
+
+    // Connections handed over by the previous master (hot upgrade)
+    for (int k = 0; k < num_inherited; k++) {
+        InheritedClient *c = &inherited[k];
+        if (c->msg.worker != worker_id || c->fd >= URING_MAX_FDS) {
+            close(c->fd);
+            continue;
+        }
+        uring_add_conn(c->fd, c->msg.player_id, c->msg.version, (time_t)c->msg.last_activity);
+        conn_integrity[c->fd] = c->msg.arg == PROTO_CRC32C ? PROTO_CRC32C : PROTO_SUM;
+    }
+    num_inherited = 0;
+
+    uring_arm_accept();
+    if (ctl_fd >= 0) uring_arm_poll(ctl_fd, UD_POLL_CTL);
+    if (udp_fd >= 0) uring_arm_poll(udp_fd, UD_POLL_UDP);
+
+    printf("Worker %d started (io_uring).\n", worker_id);
+    trace_event(TRACE_PROC_START, TRACE_ROLE_WORKER, worker_id);
+
+    while (1) {
+        uint64_t submits = ring.submits;
+        if (uring_submit(&ring, 1, URING_WAIT_MS) < 0) {
+            perror("io_uring_enter");
+            exit(1);
+        }
+        int hand_over = uring_reap(worker_id);
+        flush_moves();
+        if (hand_over) uring_hand_over(worker_id);
+
+        time_t now = time(NULL);
+        uint64_t current_version = 0;
+        game_lock(LOCK_SITE_VERSION);
+        current_version = game_state->version;
+        refresh_scores();
+        game_unlock();
+        uring_spectator_refresh();
+
+        int num_tcp = 0, num_udp = 0, num_spec = 0;
+        for (int fd = 0; fd <= uconn_max_fd; fd++) {
+            UringConn *c = &uconns[fd];
+            if (!c->open || c->closing) continue;
+            int pid = uconn_ids[fd];
+
+            if (now - c->last_activity > CLIENT_TIMEOUT_SEC) {
+                if (verbose) printf("Worker %d: Client fd %d timed out.\n", worker_id, fd);
+                trace_event(TRACE_TIMEOUT, pid, fd);
+                worker_metrics->timeouts++;
+                uring_disconnect(fd);
+                continue;
+            }
+            if (pid == SPECTATOR_ID) {
+                if (spec_latest && uconn_versions[fd] < spec_latest->tick &&
+                    c->inflight == 0 && c->out_len[1] == 0) spec_due[num_spec++] = fd; // Else a later tick
+                else push_scores(fd, &uconn_scores[fd]);
+                continue;
+            }
+            if (pid < 0) continue;
+
+            if (game_state->active_players[pid] == 0) {
+                uring_queue_reply(fd, OP_DIE, NULL, 0);
+                uring_drop_conn(fd);
+                continue;
+            }
+            if (uconn_versions[fd] < current_version && udp_session(fd, pid)) {
+                udp_due[num_udp++] = fd;
+            } else if (uconn_versions[fd] < current_version && c->inflight == 0 && c->out_len[1] == 0) {
+                tcp_due[num_tcp++] = fd;
+                continue; // Scores follow once the frame is out
+            }
+            push_scores(fd, &uconn_scores[fd]);
+        }
+        if (num_udp > 0) udp_send_updates(udp_due, num_udp, uconn_ids, uconn_versions);
+        if (num_tcp > 0) uring_send_updates(tcp_due, num_tcp);
+        if (num_spec > 0) uring_send_spectators(spec_due, num_spec);
+
+        worker_metrics->io_syscalls += ring.submits - submits;
+    }
+}
 
-    init_game_map();
+pid_t spawn_worker(int worker_id) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        perror("socketpair");
+        return -1;
+    }
 
-    // Create Socket
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd == -1) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        signal(SIGINT, SIG_IGN); // Shutdown is driven by the master
+        signal(SIGUSR2, SIG_IGN);
+        close(sv[0]);
+        for (int i = 0; i < NUM_WORKERS; i++) {
+            if (worker_ctl[i] != -1) close(worker_ctl[i]);
+        }
+        ctl_fd = sv[1];
+        trace_reopen();
+        worker_process(worker_id);
+        exit(0);
+    }
+
+    close(sv[1]);
+    if (pid < 0) {
+        close(sv[0]);
+        return pid;
+    }
+    if (worker_ctl[worker_id] != -1) close(worker_ctl[worker_id]); // Left by a dead worker
+    worker_ctl[worker_id] = sv[0];
+    return pid;
+}
+
+// Picks the CPU of each worker thread from the ones we may run on, leaving
+// out the tick loop's. "auto" (-1) takes one thread per remaining CPU.
+void plan_worker_cpus() {
+    cpu_set_t set;
+    int cpus[CPU_SETSIZE];
+    int n = 0;
+    if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+        perror("sched_getaffinity");
+        CPU_ZERO(&set);
+        CPU_SET(0, &set);
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set) && cpu != tick_cpu) cpus[n++] = cpu;
+    }
+    if (n == 0) cpus[n++] = tick_cpu; // Only CPU is the tick loop's: share it
+
+    if (num_threads < 0) num_threads = n < MAX_WORKERS ? n : MAX_WORKERS;
+    for (int i = 0; i < num_threads; i++) worker_cpus[i] = cpus[i % n];
+
+    printf("Worker threads: %d on CPUs", num_threads);
+    for (int i = 0; i < num_threads; i++) printf(" %d", worker_cpus[i]);
+    if (tick_cpu >= 0) printf(", tick loop on CPU %d", tick_cpu);
+    printf("\n");
+}
+
+// Pins the calling thread (the whole process if single-threaded)
+void pin_to_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0) perror("sched_setaffinity");
+}
+
+void *worker_thread(void *arg) {
+    int worker_id = (int)(intptr_t)arg;
+    pin_to_cpu(worker_cpus[worker_id]);
+    server_fd = open_listener(worker_cpus[worker_id]);
+    worker_process(worker_id);
+    return NULL;
+}
+
+// -threads: one process running every worker slot as a pinned thread with
+// its own listener, connections and UDP socket. Threads share only the game
+// state, like worker processes do. No control sockets, so no hot upgrade.
+pid_t spawn_worker_threads() {
+    pid_t pid = fork();
+    if (pid == 0) {
+        signal(SIGINT, SIG_IGN);
+        signal(SIGUSR2, SIG_IGN);
+        trace_reopen();
+
+        pthread_t threads[MAX_WORKERS];
+        for (int i = 0; i < num_threads; i++) {
+            if (pthread_create(&threads[i], NULL, worker_thread, (void *)(intptr_t)i) != 0) {
+                fprintf(stderr, "Could not start worker thread %d\n", i);
+                exit(1);
+            }
+        }
+        for (int i = 0; i < num_threads; i++) pthread_join(threads[i], NULL);
+        exit(0);
+    }
+    return pid;
+}
+
+pid_t spawn_game_loop() {
+    pid_t pid = fork();
+    if (pid == 0) {
+        signal(SIGINT, SIG_IGN);
+        if (tick_cpu >= 0) pin_to_cpu(tick_cpu);
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = handle_stop;
+        sigaction(SIGUSR2, &sa, NULL);
+        trace_reopen();
+        game_tick_loop();
+        exit(0);
+    }
+    return pid;
+}
+
+// A worker died: its connections are gone with it, so release its players
+void reclaim_worker_players(int worker_id) {
+    int reclaimed = 0;
+    game_lock(LOCK_SITE_CLEANUP);
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (game_state->active_players[i] && game_state->player_owner[i] == worker_id) {
+            game_remove_player(game_state, i);
+            record_input(REC_REMOVE, i, 0, 0);
+            reclaimed++;
+        }
+    }
+    game_unlock();
+
+    WorkerMetrics *w = &game_state->metrics.workers[worker_id];
+    w->connections = 0;
+    w->players = 0;
+    w->spectators = 0;
+    printf("Reclaimed %d players from worker %d.\n", reclaimed, worker_id);
+}
+
+void handle_child_exit(pid_t pid, int status) {
+    if (WIFSIGNALED(status)) {
+        printf("Child %d killed by signal %d, restarting.\n", pid, WTERMSIG(status));
+    } else {
+        printf("Child %d exited with status %d, restarting.\n", pid, WEXITSTATUS(status));
+    }
+
+    if (pid == game_loop_pid) {
+        game_loop_pid = spawn_game_loop();
+        game_state->metrics.child_restarts++;
+        trace_event(TRACE_CHILD_RESTART, TRACE_ROLE_GAME_LOOP, 0);
+        return;
+    }
+
+    if (num_threads > 0 && pid == workers[0]) {
+        for (int i = 0; i < num_threads; i++) reclaim_worker_players(i);
+        workers[0] = spawn_worker_threads();
+        game_state->metrics.child_restarts++;
+        trace_event(TRACE_CHILD_RESTART, TRACE_ROLE_WORKER, 0);
+        return;
+    }
+
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        if (workers[i] == pid) {
+            reclaim_worker_players(i);
+            workers[i] = spawn_worker(i);
+            game_state->metrics.child_restarts++;
+            trace_event(TRACE_CHILD_RESTART, TRACE_ROLE_WORKER, i);
+            return;
+        }
+    }
+}
+
+// incoming_cpu < 0: the one listener all worker processes share.
+// Otherwise one of the SO_REUSEPORT listeners of -threads mode, preferring
+// connections whose packets the kernel handles on that CPU.
+int open_listener(int incoming_cpu) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) {
         perror("socket");
         exit(1);
     }
 
     int opt = 1;
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (incoming_cpu >= 0) {
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) perror("SO_REUSEPORT");
+#ifdef SO_INCOMING_CPU
+        if (setsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &incoming_cpu, sizeof(incoming_cpu)) < 0) {
+            perror("SO_INCOMING_CPU");
+        }
+#endif
+    }
+    // All workers select() on it; the ones that lose the accept race must not
+    // block in accept() (they would stop serving, and never see an upgrade)
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
 
     struct sockaddr_in address;
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
     address.sin_port = htons(PORT);
 
-    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
         perror("bind");
         exit(1);
     }
 
-    if (listen(server_fd, 100) < 0) {
+    if (listen(fd, 100) < 0) {
         perror("listen");
         exit(1);
     }
 
-    printf("Server listening on port %d\n", PORT);
+    if (incoming_cpu < 0) printf("Server listening on port %d\n", PORT);
+    return fd;
+}
+
+// Runs the new binary with our options, minus those that only make sense
+// for a fresh world, plus -upgrade pointing at the handoff socket.
+pid_t exec_new_master() {
+    pid_t pid = fork();
+    if (pid != 0) return pid;
 
-    // Prefork Workers
+    // The new master gets the listener over the socket; drop inherited copies
+    close(server_fd);
     for (int i = 0; i < NUM_WORKERS; i++) {
-        pid_t pid = fork();
-        if (pid == 0) {
-            worker_process(i);
-            exit(0);
-        } else if (pid > 0) {
-            workers[i] = pid;
+        if (worker_ctl[i] != -1) close(worker_ctl[i]);
+    }
+    record_close();
+
+    char *args[64];
+    int n = 0;
+    args[n++] = saved_argv[0];
+    for (int i = 1; saved_argv[i] != NULL && n < 60; i++) {
+        if (strcmp(saved_argv[i], "-restore") == 0) continue;
+        if ((strcmp(saved_argv[i], "-record") == 0 || strcmp(saved_argv[i], "-upgrade") == 0) &&
+            saved_argv[i + 1] != NULL) {
+            i++;
+            continue;
+        }
+        args[n++] = saved_argv[i];
+    }
+    args[n++] = "-upgrade";
+    args[n++] = HANDOFF_SOCKET_PATH;
+    args[n] = NULL;
+
+    execv(saved_argv[0], args);
+    perror("execv");
+    _exit(127);
+}
+
+// SIGUSR2: hand the listener, the world and all client connections to a
+// freshly exec'd master, then exit without removing shared memory.
+// Returns only if the new master never showed up.
+void hot_upgrade() {
+    if (num_threads > 0) {
+        printf("Upgrade requested, but not supported with -threads\n");
+        return;
+    }
+    printf("Upgrade requested, starting %s\n", saved_argv[0]);
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, HANDOFF_SOCKET_PATH, sizeof(addr.sun_path) - 1);
+    unlink(HANDOFF_SOCKET_PATH);
+
+    int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (lfd == -1 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(lfd, 1) < 0) {
+        perror("upgrade socket");
+        if (lfd != -1) close(lfd);
+        return;
+    }
+
+    fflush(stdout);
+    pid_t pid = exec_new_master();
+    if (pid < 0) {
+        perror("fork");
+        close(lfd);
+        unlink(HANDOFF_SOCKET_PATH);
+        return;
+    }
+
+    // Nothing has changed yet; if the new binary fails to come up, keep serving
+    struct pollfd pfd = { lfd, POLLIN, 0 };
+    int conn = -1;
+    if (poll(&pfd, 1, HANDOFF_ACCEPT_TIMEOUT_SEC * 1000) == 1) {
+        conn = accept(lfd, NULL, NULL);
+    }
+    close(lfd);
+    unlink(HANDOFF_SOCKET_PATH);
+
+    HandoffMsg msg = { HANDOFF_LISTENER, -1, -1, shmid, 0, 0 };
+    if (conn == -1 || handoff_send(conn, &msg, server_fd) < 0) {
+        printf("Upgrade aborted: new master did not connect.\n");
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        if (conn != -1) close(conn);
+        return;
+    }
+
+    // Point of no return. Stop ticking first so the two game loops never overlap.
+    kill(game_loop_pid, SIGUSR2);
+    waitpid(game_loop_pid, NULL, 0);
+    game_loop_pid = 0;
+
+    int handed = 0;
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        HandoffMsg start = { HANDOFF_START, i, -1, -1, 0, 0 };
+        struct timeval tv = { HANDOFF_ACCEPT_TIMEOUT_SEC, 0 };
+        setsockopt(worker_ctl[i], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        int done = 0;
+        if (handoff_send(worker_ctl[i], &start, -1) == 0) {
+            int fd;
+            while (handoff_recv(worker_ctl[i], &msg, &fd) == 0) {
+                if (msg.type == HANDOFF_DONE) {
+                    done = 1;
+                    break;
+                }
+                if (fd < 0) continue;
+                if (handoff_send(conn, &msg, fd) == 0) handed++;
+                close(fd);
+            }
+        }
+        if (!done) {
+            printf("Worker %d did not hand over; its remaining connections are lost.\n", i);
+            kill(workers[i], SIGKILL);
+        }
+        waitpid(workers[i], NULL, 0);
+        workers[i] = 0;
+    }
+
+    msg.type = HANDOFF_DONE;
+    handoff_send(conn, &msg, -1);
+    close(conn);
+
+    game_state->metrics.upgrades++;
+    printf("Handed %d connections to new master %d, exiting.\n", handed, pid);
+    trace_close();
+    record_close();
+    checkpoint_close();
+    shmdt(game_state);
+    close(server_fd);
+    exit(0);
+}
+
+// -upgrade: take over the listener, world and connections of the old master
+int adopt_from_old_master(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock == -1 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("upgrade connect");
+        return -1;
+    }
+
+    HandoffMsg msg;
+    int fd;
+    if (handoff_recv(sock, &msg, &fd) < 0 || msg.type != HANDOFF_LISTENER || fd < 0) {
+        fprintf(stderr, "upgrade: no listener from old master\n");
+        close(sock);
+        return -1;
+    }
+    server_fd = fd;
+    shmid = msg.arg;
+    game_state = (GameState *)shmat(shmid, NULL, 0);
+    if (game_state == (void *)-1) {
+        perror("shmat");
+        game_state = NULL;
+        close(sock);
+        return -1;
+    }
+
+    while (handoff_recv(sock, &msg, &fd) == 0 && msg.type == HANDOFF_CLIENT) {
+        if (fd < 0) continue;
+        if (fd >= FD_SETSIZE || num_inherited >= FD_SETSIZE || msg.worker < 0 || msg.worker >= NUM_WORKERS) {
+            close(fd); // select() cannot serve it
+            continue;
+        }
+        inherited[num_inherited].msg = msg;
+        inherited[num_inherited].fd = fd;
+        num_inherited++;
+    }
+    close(sock);
+
+    printf("Took over world (version %llu) and %d connections from the old master.\n",
+           (unsigned long long)game_state->version, num_inherited);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *trace_prefix = NULL;
+    const char *record_path = NULL;
+    const char *checkpoint_path = NULL;
+    const char *upgrade_path = NULL;
+    int restore = 0;
+    uint64_t seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+    ratelimit_config(&rate_limit, RATE_LIMIT_PACKETS, RATE_LIMIT_BYTES);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-trace") == 0 && i + 1 < argc) {
+            trace_prefix = argv[++i];
+        } else if (strcmp(argv[i], "-record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-checkpoint") == 0 && i + 1 < argc) {
+            checkpoint_path = argv[++i];
+        } else if (strcmp(argv[i], "-restore") == 0) {
+            restore = 1;
+        } else if (strcmp(argv[i], "-upgrade") == 0 && i + 1 < argc) {
+            upgrade_path = argv[++i];
+        } else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+            i++;
+            num_threads = strcmp(argv[i], "auto") == 0 ? -1 : atoi(argv[i]);
+            if (num_threads == 0) num_threads = -2; // Rejected below
+        } else if (strcmp(argv[i], "-tick-cpu") == 0 && i + 1 < argc) {
+            tick_cpu = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-rate-limit") == 0 && i + 1 < argc) {
+            unsigned packets = 0, bytes = 0;
+            i++;
+            if (strcmp(argv[i], "off") == 0) {
+                ratelimit_config(&rate_limit, 0, 0);
+            } else if (sscanf(argv[i], "%u,%u", &packets, &bytes) == 2 && packets > 0 && bytes > 0) {
+                ratelimit_config(&rate_limit, packets, bytes);
+            } else {
+                fprintf(stderr, "-rate-limit: expected <packets/s>,<bytes/s> or off\n");
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = 1;
+        } else if (strcmp(argv[i], "-io") == 0 && i + 1 < argc &&
+                   (strcmp(argv[i + 1], "select") == 0 || strcmp(argv[i + 1], "uring") == 0)) {
+            io_backend = strcmp(argv[++i], "uring") == 0 ? IO_BACKEND_URING : IO_BACKEND_SELECT;
+        } else {
+            fprintf(stderr, "Usage: %s [-trace <prefix>] [-record <file>] [-seed n] "
+                    "[-checkpoint <file> [-restore]] [-io select|uring] "
+                    "[-threads n|auto] [-tick-cpu cpu] [-rate-limit packets,bytes|off] [-v]\n", argv[0]);
+            exit(1);
+        }
+    }
+    if (num_threads < -1 || num_threads > MAX_WORKERS) {
+        fprintf(stderr, "-threads: expected 1..%d or auto\n", MAX_WORKERS);
+        exit(1);
+    }
+    if (num_threads != 0 && upgrade_path != NULL) {
+        fprintf(stderr, "-threads does not support hot upgrade\n");
+        exit(1);
+    }
+    if (num_threads != 0) plan_worker_cpus();
+    if (upgrade_path != NULL) {
+        // The world is live in shared memory: nothing to restore, and a log
+        // started mid-game could not be replayed
+        restore = 0;
+        record_path = NULL;
+    }
+    saved_argv = argv;
+    for (int i = 0; i < NUM_WORKERS; i++) worker_ctl[i] = -1;
+
+    signal(SIGINT, handle_sigint);
+    // No SA_RESTART: these must interrupt the master's waitpid()
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_sigusr1;
+    sigaction(SIGUSR1, &sa, NULL);
+    sa.sa_handler = handle_sigusr2;
+    sigaction(SIGUSR2, &sa, NULL);
+
+    if (trace_prefix != NULL) {
+        if (trace_init(trace_prefix, TRACE_DEFAULT_CAPACITY) == 0) {
+            printf("Tracing to %s.<pid>.trace\n", trace_prefix);
+            trace_event(TRACE_PROC_START, TRACE_ROLE_MASTER, 0);
+        }
+    }
+
+    if (upgrade_path != NULL) {
+        if (adopt_from_old_master(upgrade_path) < 0) exit(1);
+    } else {
+        // Create Shared Memory
+        key_t key = ftok(SHM_KEY_FILE, SHM_KEY_ID);
+        shmid = shmget(key, sizeof(GameState), 0666 | IPC_CREAT);
+        if (shmid == -1) {
+            perror("shmget");
+            exit(1);
+        }
+
+        game_state = (GameState *)shmat(shmid, NULL, 0);
+        if (game_state == (void *)-1) {
+            perror("shmat");
+            exit(1);
+        }
+
+        init_game_map(seed);
+        printf("World seed: %llu\n", (unsigned long long)seed);
+    }
+
+    if (checkpoint_path != NULL) {
+        checkpoint_buf = malloc(sizeof(CheckpointWorld));
+        if (checkpoint_buf == NULL || checkpoint_open(checkpoint_path) < 0) {
+            exit(1);
+        }
+        checkpointing = 1;
+    }
+    if (restore && checkpointing) {
+        uint64_t t = trace_now_ns();
+        uint64_t seq = checkpoint_load(checkpoint_buf);
+        if (seq > 0) {
+            int players = checkpoint_apply(game_state, checkpoint_buf, (uint64_t)time(NULL) + RESUME_GRACE_SEC);
+            printf("Restored checkpoint #%llu (version %llu, %d players waiting to resume) in %.1f us\n",
+                   (unsigned long long)seq, (unsigned long long)game_state->version, players,
+                   (trace_now_ns() - t) / 1000.0);
         } else {
+            printf("No valid checkpoint in %s, starting a new world\n", checkpoint_path);
+        }
+        if (record_path != NULL) {
+            // A restored world is not reproducible from a seed
+            printf("-record ignored with -restore\n");
+            record_path = NULL;
+        }
+    } else if (restore) {
+        fprintf(stderr, "-restore needs -checkpoint <file>\n");
+        exit(1);
+    }
+
+    if (record_path != NULL && record_open(record_path, seed) == 0) {
+        printf("Recording inputs to %s\n", record_path);
+    }
+    if (upgrade_path == NULL) {
+        game_state->metrics.start_time = time(NULL);
+        if (num_threads == 0) server_fd = open_listener(-1); // Else each worker thread opens its own
+    }
+    game_state->metrics.num_workers = num_threads > 0 ? num_threads : NUM_WORKERS;
+
+    if (num_threads > 0) {
+        workers[0] = spawn_worker_threads();
+        if (workers[0] < 0) {
             perror("fork");
             exit(1);
         }
+    } else {
+        // Prefork Workers
+        for (int i = 0; i < NUM_WORKERS; i++) {
+            workers[i] = spawn_worker(i);
+            if (workers[i] < 0) {
+                perror("fork");
+                exit(1);
+            }
+        }
     }
+    // Workers have their inherited connections; the master must not keep them open
+    for (int k = 0; k < num_inherited; k++) close(inherited[k].fd);
+    num_inherited = 0;
 
     // Fork Game Loop
-    pid_t pid = fork();
-    if (pid == 0) {
-        game_tick_loop();
-        exit(0);
-    } else if (pid > 0) {
-        game_loop_pid = pid;
-    } else {
+    game_loop_pid = spawn_game_loop();
+    if (game_loop_pid < 0) {
         perror("fork game loop");
         exit(1);
     }
 
-    // Master waits
+    // Master waits, restarting any child that dies
     while (running) {
-        pause();
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid > 0 && running) {
+            handle_child_exit(pid, status);
+        } else if (pid == -1 && errno != EINTR) {
+            perror("waitpid");
+            sleep(1);
+        }
+        if (dump_locks) {
+            dump_locks = 0;
+            metrics_print_lock_report(&game_state->metrics, stdout);
+            fflush(stdout);
+        }
+        if (upgrade_requested) {
+            upgrade_requested = 0;
+            hot_upgrade();
+        }
     }
 
     return 0;
@@ -0,0 +1,118 @@
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+TraceRing trace_ring = { NULL, NULL, 0 };
+
+static char trace_prefix[256];
+static uint32_t trace_capacity = 0;
+static size_t trace_map_size = 0;
+
+static const char *event_names[TRACE_EVENT_MAX] = {
+    "unknown",
+    "proc_start",
+    "accept",
+    "login",
+    "login_full",
+    "logout",
+    "disconnect",
+    "timeout",
+    "death",
+    "tick",
+    "tick",
+    "move",
+    "update_sent",
+    "send_fail",
+    "lock_recovered",
+    "child_restart",
+    "flood"
+};
+
+const char *trace_event_name(uint16_t event) {
+    if (event >= TRACE_EVENT_MAX) return "unknown";
+    return event_names[event];
+}
+
+static void trace_unmap(void) {
+    if (trace_ring.header != NULL) {
+        munmap(trace_ring.header, trace_map_size);
+    }
+    trace_ring.header = NULL;
+    trace_ring.records = NULL;
+    trace_ring.mask = 0;
+}
+
+static int trace_open_file(void) {
+    char path[300];
+    snprintf(path, sizeof(path), "%s.%d.trace", trace_prefix, (int)getpid());
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        perror("trace open");
+        return -1;
+    }
+
+    size_t size = sizeof(TraceHeader) + (size_t)trace_capacity * sizeof(TraceRecord);
+    if (ftruncate(fd, size) == -1) {
+        perror("trace ftruncate");
+        close(fd);
+        return -1;
+    }
+
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        perror("trace mmap");
+        return -1;
+    }
+
+    TraceHeader *hdr = (TraceHeader *)mem;
+    struct timespec rt;
+    clock_gettime(CLOCK_REALTIME, &rt);
+    hdr->start_monotonic_ns = trace_now_ns();
+    hdr->start_realtime_ns = (uint64_t)rt.tv_sec * 1000000000ULL + (uint64_t)rt.tv_nsec;
+    hdr->version = TRACE_VERSION;
+    hdr->record_size = sizeof(TraceRecord);
+    hdr->capacity = trace_capacity;
+    hdr->head = 0;
+    hdr->pid = (uint32_t)getpid();
+    // Magic last so a reader never sees a half-initialized header as valid
+    __atomic_store_n(&hdr->magic, TRACE_MAGIC, __ATOMIC_RELEASE);
+
+    trace_map_size = size;
+    trace_ring.header = hdr;
+    trace_ring.records = (TraceRecord *)(hdr + 1);
+    trace_ring.mask = trace_capacity - 1;
+    return 0;
+}
+
+int trace_init(const char *prefix, uint32_t capacity) {
+    if (prefix == NULL || strlen(prefix) >= sizeof(trace_prefix)) return -1;
+
+    // Round capacity up to a power of two so the ring index is a mask
+    uint32_t cap = 1;
+    if (capacity == 0) capacity = TRACE_DEFAULT_CAPACITY;
+    while (cap < capacity) cap <<= 1;
+
+    trace_unmap();
+    strcpy(trace_prefix, prefix);
+    trace_capacity = cap;
+    return trace_open_file();
+}
+
+int trace_reopen(void) {
+    if (trace_capacity == 0) return 0;
+    // The inherited mapping belongs to the parent's file; drop it without touching its contents
+    trace_unmap();
+    return trace_open_file();
+}
+
+void trace_close(void) {
+    if (trace_ring.header != NULL) {
+        msync(trace_ring.header, trace_map_size, MS_ASYNC);
+    }
+    trace_unmap();
+}
@@ -0,0 +1,101 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+// Binary event tracing.
+// Each process writes fixed-size records into its own mmap'd ring file
+// (<prefix>.<pid>.trace). Records are only formatted offline by tracedump,
+// so a trace point costs one clock read and a 32-byte store.
+
+#define TRACE_MAGIC        0x45434152544B4E53ULL // "SNKTRACE"
+#define TRACE_VERSION      1
+#define TRACE_DEFAULT_CAPACITY (1 << 16) // Records per process (power of two)
+
+// Event IDs
+#define TRACE_PROC_START    1  // a0 = role (TRACE_ROLE_*), a1 = worker id
+#define TRACE_ACCEPT        2  // a0 = fd, a1 = worker id
+#define TRACE_LOGIN         3  // a0 = player id, a1 = fd
+#define TRACE_LOGIN_FULL    4  // a0 = fd
+#define TRACE_LOGOUT        5  // a0 = player id, a1 = fd
+#define TRACE_DISCONNECT    6  // a0 = player id, a1 = fd
+#define TRACE_TIMEOUT       7  // a0 = player id, a1 = fd
+#define TRACE_DEATH         8  // a0 = player id, a1 = score
+#define TRACE_TICK_BEGIN    9  // a0 = version
+#define TRACE_TICK_END      10 // a0 = version, a1 = alive snakes
+#define TRACE_MOVE          11 // a0 = player id, a1 = direction
+#define TRACE_UPDATE_SENT   12 // a0 = fd, a1 = version
+#define TRACE_SEND_FAIL     13 // a0 = fd, a1 = opcode
+#define TRACE_LOCK_RECOVERED 14 // a0 = site recovering, a1 = site of the dead owner
+#define TRACE_CHILD_RESTART 15 // a0 = role, a1 = worker id
+#define TRACE_FLOOD         16 // a0 = player id (-1 before login), a1 = fd
+#define TRACE_EVENT_MAX     17
+
+// Process roles for TRACE_PROC_START
+#define TRACE_ROLE_MASTER    0
+#define TRACE_ROLE_WORKER    1
+#define TRACE_ROLE_GAME_LOOP 2
+
+typedef struct {
+    uint64_t timestamp_ns; // CLOCK_MONOTONIC, comparable across processes
+    uint32_t pid;
+    uint16_t event;
+    uint16_t reserved;
+    uint64_t args[2];
+} TraceRecord; // 32 bytes, naturally aligned
+
+// File header, followed by `capacity` TraceRecords
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t capacity;
+    uint64_t head;              // Total records ever written (atomic)
+    uint64_t start_realtime_ns; // Wall clock at open, for absolute timestamps
+    uint64_t start_monotonic_ns;
+    uint32_t pid;
+    uint32_t padding[3];
+} TraceHeader; // 64 bytes
+
+typedef struct {
+    TraceHeader *header;
+    TraceRecord *records;
+    uint64_t mask;
+} TraceRing;
+
+extern TraceRing trace_ring;
+
+// Open <prefix>.<pid>.trace for the calling process. Returns 0 on success, -1 on failure.
+int trace_init(const char *prefix, uint32_t capacity);
+
+// Call in a forked child: drops the inherited ring and opens one for the new pid.
+// No-op if tracing was never initialized.
+int trace_reopen(void);
+
+void trace_close(void);
+
+const char *trace_event_name(uint16_t event);
+
+static inline uint64_t trace_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Hot path: safe to call from multiple threads, no-op when tracing is off
+static inline void trace_event(uint16_t event, uint64_t a0, uint64_t a1) {
+    if (trace_ring.header == NULL) return;
+    uint64_t idx = __atomic_fetch_add(&trace_ring.header->head, 1, __ATOMIC_RELAXED);
+    TraceRecord *rec = &trace_ring.records[idx & trace_ring.mask];
+    rec->pid = trace_ring.header->pid;
+    rec->event = event;
+    rec->reserved = 0;
+    rec->args[0] = a0;
+    rec->args[1] = a1;
+    // Timestamp last: the decoder treats a zero timestamp as an unfinished record
+    __atomic_store_n(&rec->timestamp_ns, trace_now_ns(), __ATOMIC_RELEASE);
+}
+
+#endif
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+// Offline decoder for the per-process trace rings written by trace.c.
+// Merges any number of <prefix>.<pid>.trace files by timestamp and prints
+// them as text or as Chrome trace JSON (chrome://tracing, Perfetto).
+
+static TraceRecord *records = NULL;
+static size_t num_records = 0;
+static size_t cap_records = 0;
+
+static const char *arg_names[TRACE_EVENT_MAX][2] = {
+    { "a0", "a1" },
+    { "role", "worker" },  // proc_start
+    { "fd", "worker" },    // accept
+    { "player", "fd" },    // login
+    { "fd", "a1" },        // login_full
+    { "player", "fd" },    // logout
+    { "player", "fd" },    // disconnect
+    { "player", "fd" },    // timeout
+    { "player", "score" }, // death
+    { "version", "a1" },   // tick begin
+    { "version", "alive" },// tick end
+    { "player", "dir" },   // move
+    { "fd", "version" },   // update_sent
+    { "fd", "opcode" },    // send_fail
+    { "site", "dead_site" },// lock_recovered
+    { "role", "worker" },  // child_restart
+    { "player", "fd" }     // flood
+};
+
+static const char *role_names[] = { "master", "worker", "game loop" };
+
+// Player ids are signed (-1 before login) and recorded sign-extended
+static const char *format_arg(char *buf, size_t len, const char *name, uint64_t value) {
+    if (strcmp(name, "player") == 0) snprintf(buf, len, "%lld", (long long)(int64_t)value);
+    else snprintf(buf, len, "%llu", (unsigned long long)value);
+    return buf;
+}
+
+static int load_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    TraceHeader hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != TRACE_MAGIC ||
+        hdr.record_size != sizeof(TraceRecord) || hdr.capacity == 0) {
+        fprintf(stderr, "%s: not a trace file\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    uint64_t count = hdr.head < hdr.capacity ? hdr.head : hdr.capacity;
+    if (hdr.head > hdr.capacity) {
+        fprintf(stderr, "%s: ring wrapped, %llu oldest records lost\n",
+                path, (unsigned long long)(hdr.head - hdr.capacity));
+    }
+
+    if (num_records + count > cap_records) {
+        cap_records = (num_records + count) * 2;
+        records = realloc(records, cap_records * sizeof(TraceRecord));
+        if (!records) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+
+    for (uint64_t i = 0; i < count; i++) {
+        TraceRecord rec;
+        if (fread(&rec, sizeof(rec), 1, f) != 1) break;
+        if (rec.timestamp_ns == 0) continue; // Writer died mid-record
+        records[num_records++] = rec;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+static int compare_records(const void *a, const void *b) {
+    const TraceRecord *ra = a, *rb = b;
+    if (ra->timestamp_ns < rb->timestamp_ns) return -1;
+    if (ra->timestamp_ns > rb->timestamp_ns) return 1;
+    return 0;
+}
+
+static void print_text(uint64_t base) {
+    for (size_t i = 0; i < num_records; i++) {
+        TraceRecord *r = &records[i];
+        uint16_t ev = r->event < TRACE_EVENT_MAX ? r->event : 0;
+        const char *name = trace_event_name(ev);
+        if (ev == TRACE_TICK_BEGIN) name = "tick_begin";
+        else if (ev == TRACE_TICK_END) name = "tick_end";
+
+        char a0[24], a1[24];
+        printf("%14.3f us  pid=%-7u %-12s %s=%s %s=%s\n",
+               (r->timestamp_ns - base) / 1000.0, r->pid, name,
+               arg_names[ev][0], format_arg(a0, sizeof(a0), arg_names[ev][0], r->args[0]),
+               arg_names[ev][1], format_arg(a1, sizeof(a1), arg_names[ev][1], r->args[1]));
+    }
+}
+
+static void print_chrome(uint64_t base) {
+    printf("{\"traceEvents\":[\n");
+    int first = 1;
+    for (size_t i = 0; i < num_records; i++) {
+        TraceRecord *r = &records[i];
+        uint16_t ev = r->event < TRACE_EVENT_MAX ? r->event : 0;
+        double ts = (r->timestamp_ns - base) / 1000.0;
+
+        if (!first) printf(",\n");
+        first = 0;
+
+        if (ev == TRACE_PROC_START) {
+            const char *role = r->args[0] < 3 ? role_names[r->args[0]] : "process";
+            printf("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,"
+                   "\"args\":{\"name\":\"%s %llu\"}}",
+                   r->pid, r->pid, role, (unsigned long long)r->args[1]);
+            continue;
+        }
+
+        const char *ph = "i";
+        if (ev == TRACE_TICK_BEGIN) ph = "B";
+        else if (ev == TRACE_TICK_END) ph = "E";
+
+        char a0[24], a1[24];
+        printf("{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":%u,\"tid\":%u,%s"
+               "\"args\":{\"%s\":%s,\"%s\":%s}}",
+               trace_event_name(ev), ph, ts, r->pid, r->pid,
+               ph[0] == 'i' ? "\"s\":\"t\"," : "",
+               arg_names[ev][0], format_arg(a0, sizeof(a0), arg_names[ev][0], r->args[0]),
+               arg_names[ev][1], format_arg(a1, sizeof(a1), arg_names[ev][1], r->args[1]));
+    }
+    printf("\n]}\n");
+}
+
+int main(int argc, char *argv[]) {
+    int chrome = 0;
+    int files = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-chrome") == 0) {
+            chrome = 1;
+        } else if (load_file(argv[i]) == 0) {
+            files++;
+        }
+    }
+
+    if (files == 0) {
+        fprintf(stderr, "Usage: %s [-chrome] <file.trace>...\n", argv[0]);
+        return 1;
+    }
+
+    qsort(records, num_records, sizeof(TraceRecord), compare_records);
+    uint64_t base = num_records > 0 ? records[0].timestamp_ns : 0;
+
+    if (chrome) print_chrome(base);
+    else print_text(base);
+
+    free(records);
+    return 0;
+}
@@ -0,0 +1,192 @@
+#include "uring.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static int sys_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void *arg, size_t argsz) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int sys_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+int uring_init(Uring *r, unsigned entries) {
+    struct io_uring_params p;
+    memset(r, 0, sizeof(*r));
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = entries * 4; // Multishot recv and broadcasts complete more than they submit
+
+    r->fd = sys_setup(entries, &p);
+    if (r->fd < 0) return -1;
+    r->features = p.features;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG)) {
+        close(r->fd);
+        errno = ENOSYS;
+        return -1;
+    }
+
+    r->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (r->cq_ring_size > r->sq_ring_size) r->sq_ring_size = r->cq_ring_size;
+    r->cq_ring_size = r->sq_ring_size; // Single mmap covers both
+
+    r->sq_ring = mmap(NULL, r->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ring == MAP_FAILED) {
+        close(r->fd);
+        return -1;
+    }
+    r->cq_ring = r->sq_ring;
+
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        munmap(r->sq_ring, r->sq_ring_size);
+        close(r->fd);
+        return -1;
+    }
+
+    char *sq = r->sq_ring;
+    r->sq_head = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->sq_entries = p.sq_entries;
+    r->sq_local_tail = *r->sq_tail;
+
+    char *cq = r->cq_ring;
+    r->cq_head = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    // Identity index mapping, set once
+    for (unsigned i = 0; i < p.sq_entries; i++) r->sq_array[i] = i;
+    return 0;
+}
+
+void uring_exit(Uring *r) {
+    if (r->fd < 0) return;
+    munmap(r->sqes, r->sqes_size);
+    munmap(r->sq_ring, r->sq_ring_size);
+    close(r->fd);
+    r->fd = -1;
+}
+
+int uring_probe(Uring *r, const int *ops, int n) {
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    if (!probe) return -1;
+    int ok = sys_register(r->fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    for (int i = 0; ok && i < n; i++) {
+        ok = ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    return ok ? 0 : -1;
+}
+
+struct io_uring_sqe *uring_get_sqe(Uring *r) {
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    if (r->sq_local_tail - head >= r->sq_entries) {
+        if (uring_submit(r, 0, 0) < 0) return NULL;
+        head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+        if (r->sq_local_tail - head >= r->sq_entries) return NULL;
+    }
+    struct io_uring_sqe *sqe = &r->sqes[r->sq_local_tail & *r->sq_mask];
+    r->sq_local_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int uring_submit(Uring *r, unsigned wait_nr, int timeout_ms) {
+    unsigned to_submit = r->sq_local_tail - *r->sq_tail;
+    __atomic_store_n(r->sq_tail, r->sq_local_tail, __ATOMIC_RELEASE);
+
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    if (timeout_ms >= 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+    }
+    unsigned flags = IORING_ENTER_EXT_ARG | (wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0);
+
+    r->submits++;
+    int ret = sys_enter(r->fd, to_submit, wait_nr, flags, &arg, sizeof(arg));
+    if (ret < 0 && (errno == ETIME || errno == EINTR)) return (int)to_submit;
+    return ret;
+}
+
+struct io_uring_cqe *uring_peek_cqe(Uring *r) {
+    unsigned head = *r->cq_head;
+    if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) return NULL;
+    return &r->cqes[head & *r->cq_mask];
+}
+
+void uring_cqe_seen(Uring *r) {
+    __atomic_store_n(r->cq_head, *r->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+int uring_register_buffers(Uring *r, const struct iovec *iov, unsigned n) {
+    return sys_register(r->fd, IORING_REGISTER_BUFFERS, (void *)iov, n);
+}
+
+int uring_setup_buf_ring(Uring *r, UringBufRing *br, uint16_t bgid, unsigned entries, unsigned buf_size) {
+    memset(br, 0, sizeof(*br));
+    size_t ring_size = entries * sizeof(struct io_uring_buf);
+    br->ring = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (br->ring == MAP_FAILED) {
+        br->ring = NULL;
+        return -1;
+    }
+    br->base = malloc((size_t)entries * buf_size);
+    if (!br->base) {
+        munmap(br->ring, ring_size);
+        br->ring = NULL;
+        return -1;
+    }
+    br->entries = entries;
+    br->buf_size = buf_size;
+    br->bgid = bgid;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)br->ring;
+    reg.ring_entries = entries;
+    reg.bgid = bgid;
+    if (sys_register(r->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        uring_buf_ring_free(br);
+        return -1;
+    }
+
+    for (unsigned i = 0; i < entries; i++) uring_buf_ring_recycle(br, (uint16_t)i);
+    return 0;
+}
+
+void uring_buf_ring_free(UringBufRing *br) {
+    if (br->ring) munmap(br->ring, br->entries * sizeof(struct io_uring_buf));
+    free(br->base);
+    br->ring = NULL;
+    br->base = NULL;
+}
+
+void uring_buf_ring_recycle(UringBufRing *br, uint16_t bid) {
+    struct io_uring_buf *buf = &br->ring->bufs[br->tail & (br->entries - 1)];
+    buf->addr = (uint64_t)(uintptr_t)uring_buf(br, bid);
+    buf->len = br->buf_size;
+    buf->bid = bid;
+    br->tail++;
+    __atomic_store_n(&br->ring->tail, br->tail, __ATOMIC_RELEASE);
+}
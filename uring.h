@@ -0,0 +1,71 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+// Minimal io_uring wrapper on the raw syscalls (no liburing), for the
+// worker I/O backend (./server -io uring). One ring per worker, used only
+// from that worker's thread. SQEs are queued with uring_get_sqe() and all
+// go to the kernel in a single io_uring_enter() from uring_submit().
+
+typedef struct {
+    int fd;
+    unsigned features;
+
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned sq_entries;
+    unsigned sq_local_tail;   // SQEs handed out; published to *sq_tail on submit
+
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+
+    uint64_t submits; // io_uring_enter() calls
+} Uring;
+
+// Provided buffer ring (IORING_REGISTER_PBUF_RING) for multishot recv:
+// the kernel picks a buffer per completion, the app hands it back when done.
+typedef struct {
+    struct io_uring_buf_ring *ring;
+    unsigned char *base;
+    unsigned entries;   // Power of two
+    unsigned buf_size;
+    uint16_t bgid;
+    uint16_t tail;
+} UringBufRing;
+
+// Returns 0, or -1 with errno set (ENOSYS/EPERM where io_uring is unavailable)
+int uring_init(Uring *r, unsigned entries);
+void uring_exit(Uring *r);
+
+// Returns 0 if the kernel supports every opcode in ops, -1 otherwise
+int uring_probe(Uring *r, const int *ops, int n);
+
+// Next free SQE, zeroed. Submits queued SQEs first if the SQ is full.
+struct io_uring_sqe *uring_get_sqe(Uring *r);
+
+// Submits queued SQEs and waits for at least wait_nr completions or
+// timeout_ms (-1 = no timeout). Returns SQEs submitted, or -1.
+int uring_submit(Uring *r, unsigned wait_nr, int timeout_ms);
+
+// Next completion or NULL; call uring_cqe_seen() after using it
+struct io_uring_cqe *uring_peek_cqe(Uring *r);
+void uring_cqe_seen(Uring *r);
+
+// Fixed buffers for IORING_RECVSEND_FIXED_BUF / *_FIXED ops
+int uring_register_buffers(Uring *r, const struct iovec *iov, unsigned n);
+
+int uring_setup_buf_ring(Uring *r, UringBufRing *br, uint16_t bgid, unsigned entries, unsigned buf_size);
+void uring_buf_ring_free(UringBufRing *br);
+void uring_buf_ring_recycle(UringBufRing *br, uint16_t bid);
+static inline unsigned char *uring_buf(UringBufRing *br, uint16_t bid) {
+    return br->base + (size_t)bid * br->buf_size;
+}
+
+#endif